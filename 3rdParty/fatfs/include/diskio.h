@@ -40,6 +40,8 @@ struct DIO {
 	DRESULT (*disk_read) (void* ctx, BYTE pdrv, BYTE* buff, LBA_t sector, UINT count);
 	DRESULT (*disk_write) (void* ctx, BYTE pdrv, const BYTE* buff, LBA_t sector, UINT count);
 	DRESULT (*disk_ioctl) (void* ctx, BYTE pdrv, BYTE cmd, void* buff);
+	int (*lock) (void* ctx);	/* Lock the volume (1:Ok, 0:timeout), optional */
+	void (*unlock) (void* ctx);	/* Unlock the volume, optional */
 };
 
 
@@ -173,6 +173,13 @@ typedef struct {
 	LBA_t	database;		/* Data base sector */
 #if FF_FS_EXFAT
 	LBA_t	bitbase;		/* Allocation bitmap base sector */
+#endif
+#if FF_FAT_CACHE_SETS
+	DWORD	fcstamp;		/* Access counter of the FAT cache */
+	LBA_t	fcsect[FF_FAT_CACHE_SETS * FF_FAT_CACHE_WAYS];	/* Sector held in each FAT cache line ((LBA_t)0 - 1:Invalid) */
+	DWORD	fcused[FF_FAT_CACHE_SETS * FF_FAT_CACHE_WAYS];	/* Last access of each FAT cache line */
+	BYTE	fcflag[FF_FAT_CACHE_SETS * FF_FAT_CACHE_WAYS];	/* FAT cache line flags (b0:dirty) */
+	BYTE	fcbuf[FF_FAT_CACHE_SETS * FF_FAT_CACHE_WAYS][FF_MAX_SS];	/* FAT cache lines */
 #endif
 	LBA_t	winsect;		/* Current sector appearing in the win[] */
 	BYTE	win[FF_MAX_SS];	/* Disk access window for Directory, FAT (and file data at tiny cfg) */
@@ -262,6 +269,21 @@ typedef struct {
 
 
 
+/* Location of a directory entry (FFLOC) */
+
+typedef struct {
+	WORD	id;				/* Volume mount ID the location is valid for */
+	LBA_t	sect;			/* Sector number containing the directory entry */
+	UINT	ofs;			/* Offset of the directory entry in the sector */
+	BYTE	sfn[11];		/* SFN of the entry to check that it still is the object */
+#if FF_FS_LOCK != 0
+	DWORD	clu;			/* Start cluster of the directory, key of the file lock */
+	DWORD	dptr;			/* Offset of the entry in the directory, key of the file lock */
+#endif
+} FFLOC;
+
+
+
 /* Format parameter structure (MKFS_PARM) */
 
 typedef struct {
@@ -300,6 +322,15 @@ typedef enum {
 } FRESULT;
 
 
+#if FF_FS_LOCK != 0
+typedef struct {
+	FATFS *fs;		/* Object ID 1, volume (NULL:blank entry) */
+	DWORD clu;		/* Object ID 2, containing directory (0:root) */
+	DWORD ofs;		/* Object ID 3, offset in the directory */
+	WORD ctr;		/* Object open counter, 0:none, 0x01..0xFF:read mode open count, 0x100:write mode */
+} FILESEM;
+#endif
+
 typedef struct {
 	DIO* dio;
 #if FF_VOLUMES < 1 || FF_VOLUMES > 10
@@ -337,6 +368,9 @@ FRESULT f_mkdir (FCTX* fctx, const TCHAR* path);								/* Create a sub director
 FRESULT f_unlink (FCTX* fctx, const TCHAR* path);								/* Delete an existing file or directory */
 FRESULT f_rename (FCTX* fctx, const TCHAR* path_old, const TCHAR* path_new);	/* Rename/Move a file or directory */
 FRESULT f_stat (FCTX* fctx, const TCHAR* path, FILINFO* fno);					/* Get file status */
+FRESULT f_locate (FCTX* fctx, FIL* fp, FFLOC* loc);							/* Get the location of the directory entry of an open file */
+FRESULT f_open_at (FCTX* fctx, FIL* fp, const FFLOC* loc, BYTE mode);			/* Open an existing file by the location of its directory entry */
+FRESULT f_stat_at (FCTX* fctx, const FFLOC* loc, FILINFO* fno);				/* Get file status by the location of its directory entry */
 FRESULT f_chmod (FCTX* fctx, const TCHAR* path, BYTE attr, BYTE mask);		/* Change attribute of a file/dir */
 FRESULT f_utime (FCTX* fctx, const TCHAR* path, const FILINFO* fno);			/* Change timestamp of a file/dir */
 FRESULT f_chdir (FCTX* fctx, const TCHAR* path);								/* Change current directory */
@@ -393,7 +427,7 @@ void ff_memfree (void* mblock);			/* Free memory block */
 
 /* Sync functions */
 #if FF_FS_REENTRANT
-int ff_cre_syncobj (BYTE vol, FF_SYNC_t* sobj);	/* Create a sync object */
+int ff_cre_syncobj (BYTE vol, DIO* dio, FF_SYNC_t* sobj);	/* Create a sync object */
 int ff_req_grant (FF_SYNC_t sobj);		/* Lock sync object */
 void ff_rel_grant (FF_SYNC_t sobj);		/* Unlock sync object */
 int ff_del_syncobj (FF_SYNC_t sobj);	/* Delete a sync object */
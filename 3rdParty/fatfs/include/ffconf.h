@@ -42,7 +42,7 @@
 /* This option switches f_mkfs() function. (0:Disable or 1:Enable) */
 
 
-#define FF_USE_FASTSEEK	0
+#define FF_USE_FASTSEEK	1
 /* This option switches fast seek function. (0:Disable or 1:Enable) */
 
 
@@ -228,6 +228,15 @@
 /  buffer in the filesystem object (FATFS) is used for the file data transfer. */
 
 
+#define FF_FAT_CACHE_SETS	4
+#define FF_FAT_CACHE_WAYS	2
+/* This set of options configures a set-associative sector cache for the FAT and
+/  the root directory area (FAT12/16), which holds sectors after they have been
+/  moved out of the sector window win[]. Dirty sectors are written back on
+/  eviction and when the filesystem is synced. Each cache line takes FF_MAX_SS
+/  bytes in the filesystem object. (0:Disable the cache by setting FF_FAT_CACHE_SETS 0) */
+
+
 #define FF_FS_EXFAT		0
 /* This option switches support for exFAT filesystem. (0:Disable or 1:Enable)
 /  To enable exFAT, also LFN needs to be enabled. (FF_USE_LFN >= 1)
@@ -273,9 +282,9 @@
 
 
 /* #include <somertos.h>	// O/S definitions */
-#define FF_FS_REENTRANT	0
+#define FF_FS_REENTRANT	1
 #define FF_FS_TIMEOUT	1000
-#define FF_SYNC_t		HANDLE
+#define FF_SYNC_t		DIO*
 /* The option FF_FS_REENTRANT switches the re-entrancy (thread safe) of the FatFs
 /  module itself. Note that regardless of this option, file access to different
 /  volume is always re-entrant and volume control functions, f_mount(), f_mkfs()
@@ -278,12 +278,6 @@
 #if FF_FS_READONLY
 #error FF_FS_LOCK must be 0 at read-only configuration
 #endif
-typedef struct {
-	FATFS *fs;		/* Object ID 1, volume (NULL:blank entry) */
-	DWORD clu;		/* Object ID 2, containing directory (0:root) */
-	DWORD ofs;		/* Object ID 3, offset in the directory */
-	WORD ctr;		/* Object open counter, 0:none, 0x01..0xFF:read mode open count, 0x100:write mode */
-} FILESEM;
 #endif
 
 
@@ -976,7 +970,9 @@ static FRESULT chk_lock (	/* Check if the file can be accessed */
 }
 
 
-static int enq_lock (void)	/* Check if an entry is available for a new object */
+static int enq_lock (	/* Check if an entry is available for a new object */
+	FCTX* fctx
+)
 {
 	UINT i;
 
@@ -1082,6 +1078,129 @@ static FRESULT sync_window (	/* Returns FR_OK or FR_DISK_ERR */
 #endif
 
 
+#if FF_FAT_CACHE_SETS
+/*-----------------------------------------------------------------------*/
+/* FAT cache: holds FAT (and FAT12/16 root directory) sectors which have */
+/* been moved out of win[]. A sector lives either in win[] or in a cache */
+/* line, never in both.                                                  */
+/*-----------------------------------------------------------------------*/
+
+static int fc_cacheable (	/* 1:The sector may be held in the FAT cache */
+	FATFS* fs,		/* Filesystem object */
+	LBA_t sect		/* Sector LBA */
+)
+{
+	/* Directory sectors in the data area are left out, since their clusters can be re-used for file data */
+	return fs->fs_type != 0 && sect - fs->fatbase < fs->database - fs->fatbase;
+}
+
+
+static void fc_invalidate (
+	FATFS* fs		/* Filesystem object */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < FF_FAT_CACHE_SETS * FF_FAT_CACHE_WAYS; i++) {
+		fs->fcsect[i] = (LBA_t)0 - 1;
+		fs->fcflag[i] = 0;
+	}
+}
+
+
+#if !FF_FS_READONLY
+static FRESULT fc_write_line (	/* Returns FR_OK or FR_DISK_ERR */
+	FATFS* fs,		/* Filesystem object */
+	UINT i			/* Cache line to write back if it is dirty */
+)
+{
+	if (fs->fcflag[i] & 1) {
+		if (fs->dio->disk_write(fs->dio->ctx, fs->pdrv, fs->fcbuf[i], fs->fcsect[i], 1) != RES_OK) return FR_DISK_ERR;
+		fs->fcflag[i] = 0;
+		if (fs->fcsect[i] - fs->fatbase < fs->fsize) {	/* Is it in the 1st FAT? */
+			if (fs->n_fats == 2) fs->dio->disk_write(fs->dio->ctx, fs->pdrv, fs->fcbuf[i], fs->fcsect[i] + fs->fsize, 1);	/* Reflect it to 2nd FAT if needed */
+		}
+	}
+	return FR_OK;
+}
+
+
+static FRESULT sync_fatcache (	/* Returns FR_OK or FR_DISK_ERR */
+	FATFS* fs		/* Filesystem object */
+)
+{
+	UINT i, n;
+	FRESULT res;
+
+
+	for (;;) {	/* Write back the dirty lines in ascending order of their sectors */
+		n = FF_FAT_CACHE_SETS * FF_FAT_CACHE_WAYS;
+		for (i = 0; i < FF_FAT_CACHE_SETS * FF_FAT_CACHE_WAYS; i++) {
+			if ((fs->fcflag[i] & 1) && (n == FF_FAT_CACHE_SETS * FF_FAT_CACHE_WAYS || fs->fcsect[i] < fs->fcsect[n])) n = i;
+		}
+		if (n == FF_FAT_CACHE_SETS * FF_FAT_CACHE_WAYS) break;
+		res = fc_write_line(fs, n);
+		if (res != FR_OK) return res;
+	}
+	return FR_OK;
+}
+#endif
+
+
+static FRESULT fc_store (	/* Returns FR_OK or FR_DISK_ERR */
+	FATFS* fs		/* Filesystem object */
+)
+{
+	UINT i, w, victim;
+#if !FF_FS_READONLY
+	FRESULT res;
+#endif
+
+
+	i = (UINT)(fs->winsect % FF_FAT_CACHE_SETS) * FF_FAT_CACHE_WAYS;	/* First line of the set */
+	for (victim = i, w = 0; w < FF_FAT_CACHE_WAYS; w++, i++) {	/* Find a free or the least recently used line */
+		if (fs->fcsect[i] == (LBA_t)0 - 1) { victim = i; break; }
+		if (fs->fcused[i] - fs->fcused[victim] > 0x7FFFFFFF) victim = i;
+	}
+#if !FF_FS_READONLY
+	res = fc_write_line(fs, victim);
+	if (res != FR_OK) return res;
+	fs->fcflag[victim] = fs->wflag;	/* Dirty state goes along with the data */
+	fs->wflag = 0;
+#endif
+	mem_cpy(fs->fcbuf[victim], fs->win, SS(fs));
+	fs->fcsect[victim] = fs->winsect;
+	fs->fcused[victim] = ++fs->fcstamp;
+	return FR_OK;
+}
+
+
+static int fc_load (	/* 1:Sector has been moved from the FAT cache into win[], 0:Not cached */
+	FATFS* fs,		/* Filesystem object */
+	LBA_t sect		/* Sector LBA */
+)
+{
+	UINT i, w;
+
+
+	i = (UINT)(sect % FF_FAT_CACHE_SETS) * FF_FAT_CACHE_WAYS;
+	for (w = 0; w < FF_FAT_CACHE_WAYS; w++, i++) {
+		if (fs->fcsect[i] == sect) {
+			mem_cpy(fs->win, fs->fcbuf[i], SS(fs));
+#if !FF_FS_READONLY
+			fs->wflag = fs->fcflag[i] & 1;
+#endif
+			fs->fcsect[i] = (LBA_t)0 - 1;
+			fs->fcflag[i] = 0;
+			return 1;
+		}
+	}
+	return 0;
+}
+#endif
+
+
 static FRESULT move_window (	/* Returns FR_OK or FR_DISK_ERR */
 	FATFS* fs,		/* Filesystem object */
 	LBA_t sect		/* Sector LBA to make appearance in the fs->win[] */
@@ -1091,10 +1210,23 @@ static FRESULT move_window (	/* Returns FR_OK or FR_DISK_ERR */
 
 
 	if (sect != fs->winsect) {	/* Window offset changed? */
+#if FF_FAT_CACHE_SETS
+		if (fc_cacheable(fs, fs->winsect)) {
+			res = fc_store(fs);			/* Keep the window in the FAT cache */
+		} else
+#endif
+		{
 #if !FF_FS_READONLY
-		res = sync_window(fs);		/* Flush the window */
+			res = sync_window(fs);		/* Flush the window */
 #endif
+		}
 		if (res == FR_OK) {			/* Fill sector window with new data */
+#if FF_FAT_CACHE_SETS
+			if (fc_cacheable(fs, sect) && fc_load(fs, sect)) {
+				fs->winsect = sect;
+				return FR_OK;
+			}
+#endif
 			if (fs->dio->disk_read(fs->dio->ctx, fs->pdrv, fs->win, sect, 1) != RES_OK) {
 				sect = (LBA_t)0 - 1;	/* Invalidate window if read data is not valid */
 				res = FR_DISK_ERR;
@@ -1121,6 +1253,9 @@ static FRESULT sync_fs (	/* Returns FR_OK or FR_DISK_ERR */
 
 
 	res = sync_window(fs);
+#if FF_FAT_CACHE_SETS
+	if (res == FR_OK) res = sync_fatcache(fs);
+#endif
 	if (res == FR_OK) {
 		if (fs->fs_type == FS_FAT32 && fs->fsi_flag == 1) {	/* FAT32: Update FSInfo sector if needed */
 			/* Create FSInfo structure */
@@ -1652,6 +1787,31 @@ static DWORD clmt_clust (	/* <2:Error, >=2:Cluster number */
 	return cl + *tbl;	/* Return the cluster number */
 }
 
+
+#if !FF_FS_READONLY
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Append a cluster to the link map table                 */
+/*-----------------------------------------------------------------------*/
+
+static void clmt_append (
+	FIL* fp,		/* Pointer to the file object */
+	DWORD clst		/* Cluster# appended to the chain */
+)
+{
+	DWORD *tbl, *frag = 0;
+
+
+	for (tbl = fp->cltbl + 1; *tbl; tbl += 2) frag = tbl;	/* Find the last fragment */
+	if (!frag) {
+		tbl[0] = 1; tbl[1] = clst; tbl[2] = 0;	/* First cluster of the file (CREATE_LINKMAP has reserved the items) */
+	} else if (frag[1] + frag[0] == clst) {
+		frag[0]++;			/* Contiguous to the last fragment, stretch it */
+	} else {
+		fp->cltbl = 0;		/* New fragment, disable fast seek mode (the table size is not known here) */
+	}
+}
+#endif
+
 #endif	/* FF_USE_FASTSEEK */
 
 
@@ -3131,6 +3291,43 @@ static FRESULT follow_path (	/* FR_OK(0): successful, !=0: error code */
 
 
 
+#if !FF_FS_READONLY && FF_FS_MINIMIZE == 0
+/*-----------------------------------------------------------------------*/
+/* Load the directory entry at a location                                */
+/*-----------------------------------------------------------------------*/
+
+static FRESULT dir_at (	/* FR_OK(0): successful, FR_NO_FILE: the entry is not the object anymore, !=0: error code */
+	DIR* dp,			/* Directory object to return the entry in, with the volume set */
+	const FFLOC* loc	/* Location of the directory entry */
+)
+{
+	FRESULT res;
+	FATFS *fs = dp->obj.fs;
+
+
+#if FF_FS_EXFAT
+	if (fs->fs_type == FS_EXFAT) return FR_NO_FILE;	/* Locations are not supported on exFAT */
+#endif
+	if (loc->id != fs->id || loc->ofs % SZDIRE || loc->ofs >= SS(fs)) return FR_NO_FILE;	/* Location of another mount? */
+	res = move_window(fs, loc->sect);
+	if (res != FR_OK) return res;
+	dp->dir = fs->win + loc->ofs;
+	if (mem_cmp(dp->dir + DIR_Name, loc->sfn, 11) != 0 || (dp->dir[DIR_Attr] & AM_VOL)) {	/* Deleted or reused for another object? */
+		return FR_NO_FILE;
+	}
+	dp->obj.attr = dp->dir[DIR_Attr] & AM_MASK;
+	dp->sect = loc->sect;
+#if FF_USE_LFN
+	dp->blk_ofs = 0xFFFFFFFF;	/* The LFN is not loaded */
+#endif
+
+	return FR_OK;
+}
+#endif
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Get logical drive number from path name                               */
 /*-----------------------------------------------------------------------*/
@@ -3287,6 +3484,9 @@ static UINT check_fs (	/* 0:FAT VBR, 1:exFAT VBR, 2:Valid BS but not FAT, 3:Inva
 )
 {
 	fs->wflag = 0; fs->winsect = (LBA_t)0 - 1;		/* Invaidate window */
+#if FF_FAT_CACHE_SETS
+	fc_invalidate(fs);
+#endif
 	if (move_window(fs, sect) != FR_OK) return 4;	/* Load the boot sector */
 
 	if (ld_word(fs->win + BS_55AA) != 0xAA55) return 3;	/* Check boot signature (always here regardless of the sector size) */
@@ -3577,7 +3777,7 @@ static FRESULT mount_volume (	/* FR_OK(0): successful, !=0: an error occurred */
 	fs->cdir = 0;			/* Initialize current directory */
 #endif
 #if FF_FS_LOCK != 0			/* Clear file lock semaphores */
-	clear_lock(fs);
+	clear_lock(fctx, fs);
 #endif
 	return FR_OK;
 }
@@ -3600,7 +3800,7 @@ static FRESULT validate (	/* Returns FR_OK or FR_INVALID_OBJECT */
 	if (obj && obj->fs && obj->fs->fs_type && obj->id == obj->fs->id) {	/* Test if the object is valid */
 #if FF_FS_REENTRANT
 		if (lock_fs(obj->fs)) {	/* Obtain the filesystem object */
-			if (!(obj->fs->dio->disk_status(obj->fs->io.ctx, obj->fs->pdrv) & STA_NOINIT)) { /* Test if the phsical drive is kept initialized */
+			if (!(obj->fs->dio->disk_status(obj->fs->dio->ctx, obj->fs->pdrv) & STA_NOINIT)) { /* Test if the phsical drive is kept initialized */
 				res = FR_OK;
 			} else {
 				unlock_fs(obj->fs, FR_OK);
@@ -3664,7 +3864,7 @@ FRESULT f_mount (
 	if (fs) {
 		fs->fs_type = 0;				/* Clear new fs object */
 #if FF_FS_REENTRANT						/* Create sync object for the new volume */
-		if (!ff_cre_syncobj((BYTE)vol, &fs->sobj)) return FR_INT_ERR;
+		if (!ff_cre_syncobj((BYTE)vol, fctx->dio, &fs->sobj)) return FR_INT_ERR;
 #endif
 	}
 	fctx->FatFs[vol] = fs;					/* Register new fs object */
@@ -3908,9 +4108,12 @@ FRESULT f_read (
 					clst = fp->obj.sclust;		/* Follow cluster chain from the origin */
 				} else {						/* Middle or end of the file */
 #if FF_USE_FASTSEEK
+					clst = 0;
 					if (fp->cltbl) {
 						clst = clmt_clust(fp, fp->fptr);	/* Get cluster# from the CLMT */
-					} else
+						if (clst == 0) fp->cltbl = 0;		/* Not in the CLMT, disable fast seek mode */
+					}
+					if (clst == 0)
 #endif
 					{
 						clst = get_fat(&fp->obj, fp->clust);	/* Follow cluster chain on the FAT */
@@ -4012,11 +4215,18 @@ FRESULT f_write (
 					clst = fp->obj.sclust;	/* Follow from the origin */
 					if (clst == 0) {		/* If no cluster is allocated, */
 						clst = create_chain(&fp->obj, 0);	/* create a new cluster chain */
+#if FF_USE_FASTSEEK
+						if (fp->cltbl && clst >= 2 && clst != 0xFFFFFFFF) clmt_append(fp, clst);
+#endif
 					}
 				} else {					/* On the middle or end of the file */
 #if FF_USE_FASTSEEK
 					if (fp->cltbl) {
 						clst = clmt_clust(fp, fp->fptr);	/* Get cluster# from the CLMT */
+						if (clst == 0) {					/* Beyond the mapped chain? */
+							clst = create_chain(&fp->obj, fp->clust);	/* Stretch the cluster chain */
+							if (clst >= 2 && clst != 0xFFFFFFFF) clmt_append(fp, clst);
+						}
 					} else
 #endif
 					{
@@ -4446,6 +4656,8 @@ FRESULT f_lseek (
 						*tbl++ = ncl; *tbl++ = tcl;
 					}
 				} while (cl < fs->n_fatent);	/* Repeat until end of chain */
+			} else {
+				ulen += 2;				/* Reserve the items of the first fragment (see clmt_append) */
 			}
 			*fp->cltbl = ulen;	/* Number of items used */
 			if (ulen <= tlen) {
@@ -4453,6 +4665,9 @@ FRESULT f_lseek (
 			} else {
 				res = FR_NOT_ENOUGH_CORE;	/* Given table size is smaller than required */
 			}
+		} else if (ofs > 0 && fp->obj.objsize > 0 &&
+			clmt_clust(fp, ((ofs < fp->obj.objsize) ? ofs : fp->obj.objsize) - 1) == 0) {	/* Not in the CLMT? */
+			fp->cltbl = 0;				/* Disable fast seek mode and seek normally */
 		} else {						/* Fast seek */
 			if (ofs > fp->obj.objsize) ofs = fp->obj.objsize;	/* Clip offset at the file size */
 			fp->fptr = ofs;				/* Set file pointer */
@@ -4475,10 +4690,11 @@ FRESULT f_lseek (
 				}
 			}
 		}
-	} else
-#endif
+	}
 
 	/* Normal Seek */
+	if (!fp->cltbl)
+#endif
 	{
 #if FF_FS_EXFAT
 		if (fs->fs_type != FS_EXFAT && ofs >= 0x100000000) ofs = 0xFFFFFFFF;	/* Clip at 4 GiB - 1 if at FATxx */
@@ -4786,6 +5002,147 @@ FRESULT f_stat (
 
 
 #if !FF_FS_READONLY
+/*-----------------------------------------------------------------------*/
+/* Get the Location of the Directory Entry of an Open File               */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_locate (
+	FCTX* fctx,
+	FIL* fp,			/* Pointer to the file object */
+	FFLOC* loc			/* Pointer to the location to return */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+
+
+	res = validate(&fp->obj, &fs);	/* Check validity of the file object */
+	if (res == FR_OK) {
+#if FF_FS_EXFAT
+		if (fs->fs_type == FS_EXFAT) LEAVE_FF(fs, FR_DENIED);	/* Locations are not supported on exFAT */
+#endif
+		res = move_window(fs, fp->dir_sect);	/* Load the directory entry */
+		if (res == FR_OK) {
+			loc->id = fs->id;
+			loc->sect = fp->dir_sect;
+			loc->ofs = (UINT)(fp->dir_ptr - fs->win);
+			mem_cpy(loc->sfn, fp->dir_ptr + DIR_Name, 11);
+#if FF_FS_LOCK != 0
+			loc->clu = fctx->Files[fp->obj.lockid - 1].clu;	/* Keep the key of the file lock, the location alone does not give it */
+			loc->dptr = fctx->Files[fp->obj.lockid - 1].ofs;
+#endif
+		}
+	}
+
+	LEAVE_FF(fs, res);
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Open an Existing File by the Location of its Directory Entry          */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_open_at (
+	FCTX* fctx,
+	FIL* fp,			/* Pointer to the blank file object */
+	const FFLOC* loc,	/* Location got by f_locate() */
+	BYTE mode			/* Access mode, files cannot be created by location */
+)
+{
+	FRESULT res;
+	DIR dj;
+	FATFS *fs;
+	const TCHAR* path = "";
+
+
+	if (!fp) return FR_INVALID_OBJECT;
+
+	/* Get logical drive */
+	mode &= FA_READ | FA_WRITE;
+	res = mount_volume(fctx, &path, &fs, mode);
+	if (res == FR_OK) {
+		dj.obj.fs = fs;
+		res = dir_at(&dj, loc);			/* Load the directory entry */
+		if (res == FR_OK) {
+			if (dj.obj.attr & AM_DIR) {		/* File open against a directory */
+				res = FR_NO_FILE;
+			} else {
+				if ((mode & FA_WRITE) && (dj.obj.attr & AM_RDO)) { /* Write mode open against R/O file */
+					res = FR_DENIED;
+				}
+			}
+		}
+#if FF_FS_LOCK != 0
+		if (res == FR_OK) {
+			dj.obj.sclust = loc->clu;		/* Key of the file lock as f_open() would have it */
+			dj.dptr = loc->dptr;
+			res = chk_lock(fctx, &dj, (mode & ~FA_READ) ? 1 : 0);	/* Check if the file can be used */
+		}
+#endif
+		if (res == FR_OK) {
+			fp->dir_sect = fs->winsect;			/* Pointer to the directory entry */
+			fp->dir_ptr = dj.dir;
+#if FF_FS_LOCK != 0
+			fp->obj.lockid = inc_lock(fctx, &dj, (mode & ~FA_READ) ? 1 : 0);	/* Lock the file for this session */
+			if (fp->obj.lockid == 0) res = FR_INT_ERR;
+		}
+		if (res == FR_OK) {
+#endif
+			fp->obj.sclust = ld_clust(fs, dj.dir);					/* Get object allocation info */
+			fp->obj.objsize = ld_dword(dj.dir + DIR_FileSize);
+#if FF_USE_FASTSEEK
+			fp->cltbl = 0;			/* Disable fast seek mode */
+#endif
+			fp->obj.fs = fs;	 	/* Validate the file object */
+			fp->obj.id = fs->id;
+			fp->flag = mode;		/* Set file access mode */
+			fp->err = 0;			/* Clear error flag */
+			fp->sect = 0;			/* Invalidate current data sector */
+			fp->fptr = 0;			/* Set file pointer top of the file */
+#if !FF_FS_TINY
+			mem_set(fp->buf, 0, sizeof fp->buf);	/* Clear sector buffer */
+#endif
+		}
+	}
+
+	if (res != FR_OK) fp->obj.fs = 0;	/* Invalidate file object on error */
+
+	LEAVE_FF(fs, res);
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Get File Status by the Location of its Directory Entry                */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_stat_at (
+	FCTX* fctx,
+	const FFLOC* loc,	/* Location got by f_locate() */
+	FILINFO* fno		/* Pointer to file information to return, fname is the SFN */
+)
+{
+	FRESULT res;
+	DIR dj;
+	const TCHAR* path = "";
+
+
+	/* Get logical drive */
+	res = mount_volume(fctx, &path, &dj.obj.fs, 0);
+	if (res == FR_OK) {
+		res = dir_at(&dj, loc);			/* Load the directory entry */
+		if (res == FR_OK && fno) get_fileinfo(&dj, fno);
+	}
+
+	LEAVE_FF(dj.obj.fs, res);
+}
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Get Number of Free Clusters                                           */
 /*-----------------------------------------------------------------------*/
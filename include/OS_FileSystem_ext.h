@@ -0,0 +1,690 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+/**
+ * @file
+ *
+ * Extensions of the OS FileSystem API which are specific to this
+ * implementation.
+ */
+
+#pragma once
+
+#include "OS_FileSystem.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Entry of the storage trace, see OS_FileSystem_ExtConfig_t. The layout is
+ * fixed, so a dump of the trace buffer can be decoded on the host with
+ * tools/trace_decode.py.
+ */
+typedef struct
+{
+    uint64_t addr;      ///< Address of the storage call
+    uint32_t size;      ///< Size of the storage call
+    uint32_t duration;  ///< Duration in clock ticks, saturated
+    uint32_t seq;       ///< Sequence number plus one, zero if not valid
+    uint8_t call;       ///< Storage call, see OS_FileSystem_StatsStorage_t
+    uint8_t op;         ///< Operation, see OS_FileSystem_StatsOp_t
+    uint8_t error;      ///< Non-zero if the call failed
+    uint8_t reserved;
+} OS_FileSystem_TraceEntry_t;
+
+/**
+ * Optional configuration of a file system instance; all-zero selects the
+ * defaults which are also used by OS_FileSystem_init().
+ */
+typedef struct
+{
+    /**
+     * Block cache between the file system and the storage. The cache is
+     * write-back, dirty blocks are written when the file system syncs, is
+     * unmounted or when they are evicted. They are written in the order they
+     * were dirtied and before any other write or erase which follows, so the
+     * storage sees the same order of programs as without the cache, which the
+     * power-loss safety of LittleFS and SPIFFS depends on. Setting
+     * @p blockCount to zero disables the cache.
+     */
+    struct
+    {
+        size_t blockSize;   ///< Size of a cached block, must fit the dataport
+        size_t blockCount;  ///< Number of blocks held in the cache
+    } cache;
+
+    /**
+     * Group commit of syncs. When a file is synced, the backend passes the
+     * changes of the file on to the block cache, which is then flushed. With
+     * group commit, the cache is flushed after the file has been released, so
+     * that files synced by other threads in the meantime are written by the
+     * same flush. Without a block cache this has no effect.
+     */
+    bool groupCommit;
+
+    /**
+     * Maximum number of files which can be open at the same time; zero
+     * selects the default of 64 handles.
+     */
+    size_t fileHandles;
+
+    /**
+     * Settings of LittleFS, zero or NULL members select the defaults. The
+     * defaults allocate all buffers on the heap and size the lookahead bitmap
+     * according to the number of blocks, up to 4096 blocks. Buffers given here
+     * must remain valid until the file system is freed.
+     */
+    struct
+    {
+        size_t cacheSize;       ///< Size of the caches, must divide block size
+        size_t lookaheadSize;   ///< Size of lookahead bitmap, multiple of 8
+        void* readBuffer;       ///< Read cache of cacheSize bytes
+        void* progBuffer;       ///< Program cache of cacheSize bytes
+        void* lookaheadBuffer;  ///< Lookahead bitmap of lookaheadSize bytes
+        void* fileBuffers;      ///< File caches, cacheSize bytes per handle
+    } littleFs;
+
+    /**
+     * Settings of SPIFFS. With @p nameIndex, the names of all files are kept
+     * in RAM along with where SPIFFS stores them, so opening a file does not
+     * scan the flash for its name and names which do not exist are rejected
+     * right away. The index is built when the file system is mounted and
+     * takes about SPIFFS_OBJ_NAME_LEN + 16 bytes per file.
+     */
+    struct
+    {
+        bool nameIndex;         ///< Keep an index of the file names in RAM
+    } spifFs;
+
+    /**
+     * Queue of asynchronous requests, see OS_FileSystemFile_readAsync().
+     * Setting @p queueSize to zero disables the asynchronous interface.
+     */
+    struct
+    {
+        size_t queueSize;   ///< Number of requests which can be pending
+    } async;
+
+    /**
+     * Locks which make the file system safe to be used by several threads;
+     * locking is enabled by providing all callbacks. The file system creates
+     * one lock for the instance, one for the backend and the request queue and
+     * one for each open file. Reads and writes of a file hold the instance
+     * lock shared and the lock of the file exclusively, all other operations
+     * hold the instance lock exclusively.
+     *
+     * Since all backends share the storage dataport and the caches, their
+     * calls are still serialized by the backend lock; FatFs holds it itself
+     * for each of its calls.
+     */
+    struct
+    {
+        void* ctx;  ///< Context passed to the callbacks
+        /// Create a reader/writer lock, returns NULL on failure
+        void* (*create)(void* ctx);
+        /// Destroy a lock which was created before
+        void (*destroy)(void* ctx, void* lock);
+        /// Acquire a lock shared or exclusively, may fail with a timeout
+        OS_Error_t (*acquire)(void* ctx, void* lock, bool exclusive);
+        /// Release a lock the way it was acquired
+        void (*release)(void* ctx, void* lock, bool exclusive);
+    } lock;
+
+    /**
+     * Read-ahead for files which are read sequentially. While such a file is
+     * read, reads of the storage are extended up to a window which starts at
+     * a quarter of @p size and doubles with each sequential read; the data is
+     * kept in a buffer from which the following reads are served. Files can
+     * be opened with an access pattern hint, see
+     * OS_FileSystem_OpenFlags_SEQUENTIAL. Setting @p size to zero disables
+     * read-ahead, it is limited to the size of the dataport.
+     */
+    struct
+    {
+        size_t size;    ///< Size of the read-ahead buffer
+    } readAhead;
+
+    /**
+     * Combining of small writes. Each open file gets a buffer of @p size
+     * bytes, which collects writes as long as each continues the previous one;
+     * the buffer is written to the file when it is full, when a write does not
+     * continue it, before the file is read, synced or closed and when the file
+     * system is unmounted. An error of such a write is returned by the call
+     * which caused it and the buffered data is dropped; a file is closed even
+     * then. Writes to files opened read-only are not buffered. If @p maxAge is
+     * set, the buffer is also written by the first write that comes @p maxAge
+     * ticks of the clock of the statistics after the data was buffered.
+     * Setting @p size to zero disables it.
+     */
+    struct
+    {
+        size_t size;        ///< Size of the buffer of each open file
+        uint64_t maxAge;    ///< Age of buffered data in ticks, zero for none
+    } writeCombine;
+
+    /**
+     * Cache of file names. For each name it holds the file the name was last
+     * found to refer to, or that there is no file of that name; a file in the
+     * cache is opened without looking up its name again, a name without a
+     * file fails right away with OS_ERROR_NOT_FOUND. Creating and deleting
+     * files updates the cache. Only FatFs can open files by their directory
+     * entry, with the other backends only the missing names are cached. Names
+     * of OS_FILESYSTEM_NAME_CACHE_NAME_LEN characters or more are not cached.
+     * Setting @p entries to zero disables the cache.
+     */
+    struct
+    {
+        size_t entries;     ///< Number of names held in the cache
+    } nameCache;
+
+    /**
+     * Collection of statistics, if built with OS_FILESYSTEM_WITH_STATISTICS.
+     * Without a clock, calls are counted but their durations are not taken.
+     */
+    struct
+    {
+        /// Monotonic clock, the unit of its ticks is up to the caller
+        uint64_t (*clock)(void);
+    } stats;
+
+    /**
+     * Trace of all calls of the storage, if built with
+     * OS_FILESYSTEM_WITH_TRACE. The buffer is used as a ring, each call
+     * overwrites the oldest entry; it is written without locks, so it can be
+     * dumped at any time. The durations are taken with the clock of the
+     * statistics. A NULL buffer disables the trace.
+     */
+    struct
+    {
+        OS_FileSystem_TraceEntry_t* buffer;
+        size_t entries;     ///< Number of entries in the buffer
+    } trace;
+} OS_FileSystem_ExtConfig_t;
+
+/**
+ * Counters of the block cache.
+ */
+typedef struct
+{
+    uint64_t hits;          ///< Accesses served (or absorbed) by the cache
+    uint64_t misses;        ///< Accesses which had to go to the storage
+    uint64_t writeBacks;    ///< Dirty blocks written to the storage
+    uint64_t evictions;     ///< Valid blocks replaced by other blocks
+} OS_FileSystem_CacheStats_t;
+
+/**
+ * Operations of the file system which are counted in the statistics.
+ */
+typedef enum
+{
+    OS_FileSystem_StatsOp_OPEN,
+    OS_FileSystem_StatsOp_CLOSE,
+    OS_FileSystem_StatsOp_READ,
+    OS_FileSystem_StatsOp_WRITE,
+    OS_FileSystem_StatsOp_SYNC,
+    OS_FileSystem_StatsOp_DELETE,
+    OS_FileSystem_StatsOp_GET_SIZE,
+    OS_FileSystem_StatsOp_FORMAT,
+    OS_FileSystem_StatsOp_MOUNT,
+    OS_FileSystem_StatsOp_UNMOUNT,
+    OS_FileSystem_StatsOp_WIPE,
+    OS_FileSystem_StatsOp_MAX
+} OS_FileSystem_StatsOp_t;
+
+/**
+ * Calls of the storage which are counted in the statistics; each transfer
+ * through the dataport counts as one call.
+ */
+typedef enum
+{
+    OS_FileSystem_StatsStorage_READ,
+    OS_FileSystem_StatsStorage_WRITE,
+    OS_FileSystem_StatsStorage_ERASE,
+    OS_FileSystem_StatsStorage_MAX
+} OS_FileSystem_StatsStorage_t;
+
+/**
+ * Number of buckets of the latency histograms.
+ */
+#define OS_FileSystem_STATS_BUCKETS 32
+
+/**
+ * Counters of an operation or storage call.
+ */
+typedef struct
+{
+    uint64_t count;     ///< Number of calls
+    uint64_t errors;    ///< Number of calls which failed
+    uint64_t bytes;     ///< Bytes transferred by successful calls
+    uint64_t time;      ///< Sum of the durations of all calls, in clock ticks
+    /**
+     * Latency histogram; bucket 0 counts calls which took less than a tick,
+     * bucket i counts calls which took from 2^(i-1) to 2^i - 1 ticks. The
+     * last bucket also takes all longer calls.
+     */
+    uint64_t histogram[OS_FileSystem_STATS_BUCKETS];
+} OS_FileSystem_CallStats_t;
+
+/**
+ * Statistics of a file system.
+ */
+typedef struct
+{
+    OS_FileSystem_CallStats_t ops[OS_FileSystem_StatsOp_MAX];
+    OS_FileSystem_CallStats_t storage[OS_FileSystem_StatsStorage_MAX];
+    OS_FileSystem_CacheStats_t cache;   ///< All zero without block cache
+} OS_FileSystem_Stats_t;
+
+/**
+ * Initialize a file system with an extended configuration.
+ *
+ * @param self (required) pointer to handle of the file system
+ * @param cfg (required) configuration as for OS_FileSystem_init()
+ * @param extCfg (optional) extended configuration, NULL selects the defaults
+ *
+ * @return an error code
+ * @retval OS_SUCCESS if operation succeeded
+ * @retval OS_ERROR_INVALID_PARAMETER if a parameter was missing or invalid
+ * @retval OS_ERROR_INSUFFICIENT_SPACE if allocation of memory failed
+ */
+OS_Error_t
+OS_FileSystem_initExt(
+    OS_FileSystem_Handle_t*          self,
+    const OS_FileSystem_Config_t*    cfg,
+    const OS_FileSystem_ExtConfig_t* extCfg);
+
+/**
+ * Erase the whole storage of a file system, e.g., to provision it anew. The
+ * storage is erased in as few calls as possible, each covering a run of erase
+ * blocks of the file system (see OS_FileSystem_Format_t); blocks which are
+ * known to be erased since a previous wipe and have not been written since are
+ * skipped.
+ *
+ * The file system must not be mounted and no file may be open; it has to be
+ * formatted before it can be mounted again.
+ *
+ * @param self (required) handle of the file system
+ *
+ * @return an error code
+ * @retval OS_SUCCESS if operation succeeded
+ * @retval OS_ERROR_INVALID_PARAMETER if a parameter was missing or invalid
+ * @retval OS_ERROR_INVALID_STATE if the file system is mounted or a file is
+ *  open
+ * @retval OS_ERROR_INSUFFICIENT_SPACE if allocation of memory failed
+ */
+OS_Error_t
+OS_FileSystem_wipe(
+    OS_FileSystem_Handle_t self);
+
+/**
+ * Sync all open files of a file system and write everything which is held
+ * back in the block cache with a single flush.
+ *
+ * @param self (required) handle of the file system
+ *
+ * @return an error code; if several files fail to sync, that of the first
+ * @retval OS_SUCCESS if operation succeeded
+ * @retval OS_ERROR_INVALID_PARAMETER if a parameter was missing or invalid
+ */
+OS_Error_t
+OS_FileSystem_sync(
+    OS_FileSystem_Handle_t self);
+
+/**
+ * Get the counters of the block cache.
+ *
+ * @param self (required) handle of the file system
+ * @param stats (required) pointer to counters to be filled
+ *
+ * @return an error code
+ * @retval OS_SUCCESS if operation succeeded
+ * @retval OS_ERROR_INVALID_PARAMETER if a parameter was missing or invalid
+ * @retval OS_ERROR_NOT_SUPPORTED if the block cache is not enabled
+ */
+OS_Error_t
+OS_FileSystem_getCacheStats(
+    OS_FileSystem_Handle_t      self,
+    OS_FileSystem_CacheStats_t* stats);
+
+/**
+ * Get the statistics of the file system.
+ *
+ * @param self (required) handle of the file system
+ * @param stats (required) pointer to statistics to be filled
+ *
+ * @return an error code
+ * @retval OS_SUCCESS if operation succeeded
+ * @retval OS_ERROR_INVALID_PARAMETER if a parameter was missing or invalid
+ * @retval OS_ERROR_NOT_SUPPORTED if not built with
+ *  OS_FILESYSTEM_WITH_STATISTICS
+ */
+OS_Error_t
+OS_FileSystem_getStats(
+    OS_FileSystem_Handle_t self,
+    OS_FileSystem_Stats_t* stats);
+
+/**
+ * Reset the statistics of the file system, including the counters of the
+ * block cache.
+ *
+ * @param self (required) handle of the file system
+ *
+ * @return an error code
+ * @retval OS_SUCCESS if operation succeeded
+ * @retval OS_ERROR_INVALID_PARAMETER if a parameter was missing or invalid
+ * @retval OS_ERROR_NOT_SUPPORTED if not built with
+ *  OS_FILESYSTEM_WITH_STATISTICS
+ */
+OS_Error_t
+OS_FileSystem_resetStats(
+    OS_FileSystem_Handle_t self);
+
+/**
+ * Segment of a vectored read or write.
+ */
+typedef struct
+{
+    void* buffer;   ///< Data of the segment
+    size_t len;     ///< Length of the segment in bytes
+} OS_FileSystemFile_IoVec_t;
+
+/**
+ * Access pattern hints, which can be added to the flags passed to
+ * OS_FileSystemFile_open() for the read-ahead (see OS_FileSystem_ExtConfig_t).
+ * A file opened with OS_FileSystem_OpenFlags_SEQUENTIAL is read ahead by the
+ * full window from the first read on, a file opened with
+ * OS_FileSystem_OpenFlags_RANDOM is never read ahead. Without a hint, the
+ * window grows as long as the file is read sequentially.
+ */
+#define OS_FileSystem_OpenFlags_SEQUENTIAL \
+    ((OS_FileSystem_OpenFlags_t) (1u << 8))
+#define OS_FileSystem_OpenFlags_RANDOM \
+    ((OS_FileSystem_OpenFlags_t) (1u << 9))
+
+/**
+ * Offset which can be passed to OS_FileSystemFile_read() and
+ * OS_FileSystemFile_write() to continue at the current position of the file,
+ * i.e., right behind the data which was read or written last. After opening,
+ * the current position is the start of the file.
+ */
+#define OS_FileSystemFile_OFFSET_CURRENT ((off_t) -1)
+
+/**
+ * Read from a file at its current position, see
+ * OS_FileSystemFile_OFFSET_CURRENT.
+ *
+ * @param self (required) handle of the file system
+ * @param hFile (required) handle of the file
+ * @param len (required) number of bytes to read
+ * @param buffer (required) buffer to read into
+ *
+ * @return an error code, see OS_FileSystemFile_read()
+ */
+OS_Error_t
+OS_FileSystemFile_readNext(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile,
+    const size_t               len,
+    void*                      buffer);
+
+/**
+ * Write to a file at its current position, see
+ * OS_FileSystemFile_OFFSET_CURRENT.
+ *
+ * @param self (required) handle of the file system
+ * @param hFile (required) handle of the file
+ * @param len (required) number of bytes to write
+ * @param buffer (required) buffer to write from
+ *
+ * @return an error code, see OS_FileSystemFile_write()
+ */
+OS_Error_t
+OS_FileSystemFile_writeNext(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile,
+    const size_t               len,
+    const void*                buffer);
+
+/**
+ * Read from a file into several buffers. The segments are filled one after the
+ * other from consecutive data of the file, so a vectored read behaves like a
+ * sequence of reads at the current position, but the file is only positioned
+ * once.
+ *
+ * @param self (required) handle of the file system
+ * @param hFile (required) handle of the file
+ * @param offset (required) offset in the file or
+ *  OS_FileSystemFile_OFFSET_CURRENT
+ * @param iov (required) segments to read into
+ * @param iovCount (required) number of segments
+ *
+ * @return an error code, see OS_FileSystemFile_read()
+ */
+OS_Error_t
+OS_FileSystemFile_readv(
+    OS_FileSystem_Handle_t           self,
+    OS_FileSystemFile_Handle_t       hFile,
+    const off_t                      offset,
+    const OS_FileSystemFile_IoVec_t* iov,
+    const size_t                     iovCount);
+
+/**
+ * Write several buffers to a file as consecutive data. The segments pass the
+ * caches of the file system back to back, so small segments are combined
+ * before anything is written to the storage.
+ *
+ * @param self (required) handle of the file system
+ * @param hFile (required) handle of the file
+ * @param offset (required) offset in the file or
+ *  OS_FileSystemFile_OFFSET_CURRENT
+ * @param iov (required) segments to write
+ * @param iovCount (required) number of segments
+ *
+ * @return an error code, see OS_FileSystemFile_write()
+ */
+OS_Error_t
+OS_FileSystemFile_writev(
+    OS_FileSystem_Handle_t           self,
+    OS_FileSystemFile_Handle_t       hFile,
+    const off_t                      offset,
+    const OS_FileSystemFile_IoVec_t* iov,
+    const size_t                     iovCount);
+
+/**
+ * Flush all data written to a file to the storage, including the data held in
+ * the block cache.
+ *
+ * @param self (required) handle of the file system
+ * @param hFile (required) handle of the file
+ *
+ * @return an error code
+ * @retval OS_SUCCESS if operation succeeded
+ * @retval OS_ERROR_INVALID_PARAMETER if a parameter was missing or invalid
+ * @retval OS_ERROR_INVALID_HANDLE if the file handle is not valid
+ */
+OS_Error_t
+OS_FileSystemFile_sync(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile);
+
+/**
+ * Get the size of an open file from its state in the file system, without
+ * looking up its name. The size includes data which has been written but not
+ * synced yet. OS_FileSystemFile_getSize() takes the size this way as well if
+ * the file of the given name is open.
+ *
+ * @param self (required) handle of the file system
+ * @param hFile (required) handle of the file
+ * @param sz (required) pointer to the size to be filled
+ *
+ * @return an error code
+ * @retval OS_SUCCESS if operation succeeded
+ * @retval OS_ERROR_INVALID_PARAMETER if a parameter was missing or invalid
+ * @retval OS_ERROR_INVALID_HANDLE if the file handle is not valid
+ */
+OS_Error_t
+OS_FileSystemFile_getSizeByHandle(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile,
+    off_t*                     sz);
+
+/**
+ * Token identifying an asynchronous request.
+ */
+typedef uint32_t OS_FileSystem_AsyncToken_t;
+
+/**
+ * Completion callback of an asynchronous request. It is called from
+ * OS_FileSystem_processAsync() and may submit further requests.
+ *
+ * @param ctx context given when the request was submitted
+ * @param token token of the completed request
+ * @param err result of the request, as returned by the synchronous call
+ */
+typedef void (*OS_FileSystem_AsyncCallback_t)(
+    void*                      ctx,
+    OS_FileSystem_AsyncToken_t token,
+    OS_Error_t                 err);
+
+/**
+ * Submit an asynchronous read. The request is queued and executed by a later
+ * call of OS_FileSystem_processAsync(); until then, @p buffer must remain
+ * valid. Requests are executed in the order of their submission.
+ *
+ * If a @p callback is given, it is called on completion and the token becomes
+ * invalid afterwards. Otherwise the result is kept until it is picked up with
+ * OS_FileSystem_pollAsync(), which also releases the request. Results which
+ * are never picked up occupy their place in the queue until the file is
+ * closed.
+ *
+ * Without the locks of OS_FileSystem_ExtConfig_t, the asynchronous functions
+ * and OS_FileSystem_processAsync() must not be called concurrently on the
+ * same file system.
+ *
+ * @param self (required) handle of the file system
+ * @param hFile (required) handle of the file
+ * @param offset (required) offset in the file or
+ *  OS_FileSystemFile_OFFSET_CURRENT
+ * @param len (required) number of bytes to read
+ * @param buffer (required) buffer to read into
+ * @param callback (optional) completion callback
+ * @param ctx (optional) context passed to the callback
+ * @param token (required) pointer to token of the request
+ *
+ * @return an error code
+ * @retval OS_SUCCESS if the request was queued
+ * @retval OS_ERROR_INVALID_PARAMETER if a parameter was missing or invalid
+ * @retval OS_ERROR_INVALID_HANDLE if the file handle is not valid
+ * @retval OS_ERROR_NOT_SUPPORTED if the request queue is not enabled
+ * @retval OS_ERROR_TRY_AGAIN if the request queue is full
+ */
+OS_Error_t
+OS_FileSystemFile_readAsync(
+    OS_FileSystem_Handle_t        self,
+    OS_FileSystemFile_Handle_t    hFile,
+    const off_t                   offset,
+    const size_t                  len,
+    void*                         buffer,
+    OS_FileSystem_AsyncCallback_t callback,
+    void*                         ctx,
+    OS_FileSystem_AsyncToken_t*   token);
+
+/**
+ * Submit an asynchronous write, see OS_FileSystemFile_readAsync().
+ *
+ * @param self (required) handle of the file system
+ * @param hFile (required) handle of the file
+ * @param offset (required) offset in the file or
+ *  OS_FileSystemFile_OFFSET_CURRENT
+ * @param len (required) number of bytes to write
+ * @param buffer (required) buffer to write from
+ * @param callback (optional) completion callback
+ * @param ctx (optional) context passed to the callback
+ * @param token (required) pointer to token of the request
+ *
+ * @return an error code, see OS_FileSystemFile_readAsync()
+ */
+OS_Error_t
+OS_FileSystemFile_writeAsync(
+    OS_FileSystem_Handle_t        self,
+    OS_FileSystemFile_Handle_t    hFile,
+    const off_t                   offset,
+    const size_t                  len,
+    const void*                   buffer,
+    OS_FileSystem_AsyncCallback_t callback,
+    void*                         ctx,
+    OS_FileSystem_AsyncToken_t*   token);
+
+/**
+ * Submit an asynchronous OS_FileSystemFile_sync(), see
+ * OS_FileSystemFile_readAsync(). It completes once all requests submitted
+ * before have been executed and the file was flushed.
+ *
+ * @param self (required) handle of the file system
+ * @param hFile (required) handle of the file
+ * @param callback (optional) completion callback
+ * @param ctx (optional) context passed to the callback
+ * @param token (required) pointer to token of the request
+ *
+ * @return an error code, see OS_FileSystemFile_readAsync()
+ */
+OS_Error_t
+OS_FileSystemFile_syncAsync(
+    OS_FileSystem_Handle_t        self,
+    OS_FileSystemFile_Handle_t    hFile,
+    OS_FileSystem_AsyncCallback_t callback,
+    void*                         ctx,
+    OS_FileSystem_AsyncToken_t*   token);
+
+/**
+ * Execute queued asynchronous requests. This is the worker of the request
+ * queue; it is meant to be called from the loop or thread of the component
+ * which drives the storage, while other work proceeds on the submitting side.
+ * Closing a file or unmounting the file system executes all queued requests
+ * first.
+ *
+ * If the lock of the queue cannot be acquired, the error of the lock callback
+ * is returned; a request which was executed is still completed. Closing a
+ * file or unmounting fails with that error as well.
+ *
+ * @param self (required) handle of the file system
+ * @param maxRequests (required) maximum number of requests to execute
+ * @param processed (optional) pointer to number of executed requests
+ *
+ * @return an error code
+ * @retval OS_SUCCESS if operation succeeded
+ * @retval OS_ERROR_INVALID_PARAMETER if a parameter was missing or invalid
+ * @retval OS_ERROR_NOT_SUPPORTED if the request queue is not enabled
+ */
+OS_Error_t
+OS_FileSystem_processAsync(
+    OS_FileSystem_Handle_t self,
+    const size_t           maxRequests,
+    size_t*                processed);
+
+/**
+ * Get the result of an asynchronous request which was submitted without a
+ * callback. Once the result was returned, the token becomes invalid.
+ *
+ * @param self (required) handle of the file system
+ * @param token (required) token of the request
+ * @param result (required) pointer to result of the request
+ *
+ * @return an error code
+ * @retval OS_SUCCESS if the request has completed and @p result was set
+ * @retval OS_ERROR_INVALID_PARAMETER if a parameter was missing or invalid
+ * @retval OS_ERROR_IN_PROGRESS if the request has not been executed yet
+ * @retval OS_ERROR_NOT_FOUND if the token is not valid (anymore)
+ * @retval OS_ERROR_NOT_SUPPORTED if the request queue is not enabled
+ */
+OS_Error_t
+OS_FileSystem_pollAsync(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystem_AsyncToken_t token,
+    OS_Error_t*                result);
@@ -9,6 +9,17 @@
 #pragma once
 
 #include "OS_FileSystem.h"
+#include "OS_FileSystem_ext.h"
+
+#include "lib/AsyncQueue.h"
+#include "lib/BlockCache.h"
+#include "lib/HandleBitmap.h"
+#include "lib/Lock.h"
+#include "lib/NameCache.h"
+#include "lib/ReadAhead.h"
+#include "lib/SpifFsIndex.h"
+#include "lib/WriteCombine.h"
+#include "lib/Trace.h"
 
 // For LittleFS
 #include "lfs.h"
@@ -33,6 +44,8 @@ typedef struct
 
 typedef struct
 {
+    size_t fileSize;    // Size of the state of an open file
+    bool selfLocking;   // Backend acquires the backend lock for its calls
     OS_Error_t (*open) (OS_FileSystem_Handle_t          self,
                         OS_FileSystemFile_Handle_t      hFile,
                         const char*                     name,
@@ -40,35 +53,69 @@ typedef struct
                         const OS_FileSystem_OpenFlags_t flags);
     OS_Error_t (*close)(OS_FileSystem_Handle_t     self,
                         OS_FileSystemFile_Handle_t hFile);
-    OS_Error_t (*read) (OS_FileSystem_Handle_t     self,
-                        OS_FileSystemFile_Handle_t hFile,
-                        const off_t                offset,
-                        const size_t               len,
-                        void*                      buffer);
-    OS_Error_t (*write)(OS_FileSystem_Handle_t     self,
-                        OS_FileSystemFile_Handle_t hFile,
-                        const off_t                offset,
-                        const size_t               len,
-                        const void*                buffer);
+    OS_Error_t (*readv) (OS_FileSystem_Handle_t           self,
+                         OS_FileSystemFile_Handle_t       hFile,
+                         const off_t                      offset,
+                         const OS_FileSystemFile_IoVec_t* iov,
+                         const size_t                     iovCount);
+    OS_Error_t (*writev)(OS_FileSystem_Handle_t           self,
+                         OS_FileSystemFile_Handle_t       hFile,
+                         const off_t                      offset,
+                         const OS_FileSystemFile_IoVec_t* iov,
+                         const size_t                     iovCount);
+    OS_Error_t (*sync) (OS_FileSystem_Handle_t     self,
+                        OS_FileSystemFile_Handle_t hFile);
     OS_Error_t (*delete)(OS_FileSystem_Handle_t self,
                          const char*            name);
     OS_Error_t (*getSize)(OS_FileSystem_Handle_t self,
                           const char*            name,
                           off_t*                 sz);
+    OS_Error_t (*getSizeByHandle)(OS_FileSystem_Handle_t     self,
+                                  OS_FileSystemFile_Handle_t hFile,
+                                  off_t*                     sz);
+    // Optional, for backends which can find a file by its identity; they
+    // return OS_ERROR_NOT_FOUND if the identity does not fit the file anymore
+    OS_Error_t (*getId)(OS_FileSystem_Handle_t     self,
+                        OS_FileSystemFile_Handle_t hFile,
+                        NameCache_Id_t*            id);
+    OS_Error_t (*openById)(OS_FileSystem_Handle_t         self,
+                           OS_FileSystemFile_Handle_t     hFile,
+                           const NameCache_Id_t*          id,
+                           const OS_FileSystem_OpenMode_t mode);
+    OS_Error_t (*getSizeById)(OS_FileSystem_Handle_t self,
+                              const NameCache_Id_t*  id,
+                              off_t*                 sz);
 } OS_FileSystem_FileOps_t;
 
 /*
- * Type of the usage bit-field.
- * Each open file handle is represented by a bit in the usage bit-field.
+ * Default number of file handles, if none is given in the extended
+ * configuration.
  */
-typedef uint64_t UsageBitField_t;
+#define DEFAULT_FILE_HANDLES    64
 
 /*
- * Maximum number of file handles.
- * The possible number of file handles is limited by the bit-width of the data
- * type used for the usage bit-field.
+ * Number of DWORDs in each of the pooled FatFs cluster link map tables. A table
+ * of N items maps a file of up to (N - 2) / 2 fragments; larger tables are
+ * allocated on the heap when the file is opened.
  */
-#define MAX_FILE_HANDLES    (sizeof(UsageBitField_t) * 8)
+#if !defined(OS_FILESYSTEM_FATFS_CLMT_SIZE)
+#define OS_FILESYSTEM_FATFS_CLMT_SIZE   32
+#endif
+
+// State of an open LittleFS file
+typedef struct
+{
+    lfs_file_t fh;
+    struct lfs_file_config cfg;
+} LittleFs_File_t;
+
+// State of an open FatFs file
+typedef struct
+{
+    FIL fh;
+    DWORD clmt[OS_FILESYSTEM_FATFS_CLMT_SIZE];
+    DWORD* clmtHeap;
+} FatFs_File_t;
 
 // Hidden definition of struct
 struct OS_FileSystem
@@ -76,33 +123,65 @@ struct OS_FileSystem
     const OS_FileSystem_FsOps_t* fsOps;
     const OS_FileSystem_FileOps_t* fileOps;
     OS_FileSystem_Config_t cfg;
-    OS_Error_t ioError;
+    OS_FileSystem_ExtConfig_t extCfg;
+    BlockCache_t cache;
+    // Erase blocks which are known to be erased, see Storage_wipe()
+    struct
+    {
+        uint8_t* map;
+        off_t blockSize;
+    } erased;
+    // Range of adjacent erases which are held back, see Storage_erase()
+    struct
+    {
+        off_t addr;
+        off_t size;
+    } pendingErase;
+    ReadAhead_t readAhead;
+    NameCache_t nameCache;
     union
     {
         struct
         {
             lfs_t fs;
             struct lfs_config cfg;
-            lfs_file_t fh[MAX_FILE_HANDLES];
         } littleFs;
         struct
         {
             DIO dio;
             FCTX fctx;
             FATFS fs;
-            FIL fh[MAX_FILE_HANDLES];
             uint8_t buffer[FF_MAX_SS];
         } fatFs;
         struct
         {
             spiffs fs;
             spiffs_config cfg;
-            spiffs_file fh[MAX_FILE_HANDLES];
-            uint8_t fds[MAX_FILE_HANDLES * sizeof(spiffs_fd)];
+            uint8_t* fds;
             uint8_t* workBuf;
             uint8_t* cacheBuf;
             size_t cacheSize;
+            SpifFsIndex_t index;
         } spifFs;
     } fs;
-    UsageBitField_t usageBitField;
+    // Set from a successful mount to a successful unmount
+    bool mounted;
+    HandleBitmap_t handles;
+    // State of the open files, allocated when a file is opened
+    void** files;
+    // Names of the open files, to find them by name
+    char** names;
+    AsyncQueue_t async;
+    WriteCombine_t writeCombine;
+    Lock_t lock;
+#if defined(OS_FILESYSTEM_WITH_STATISTICS)
+    struct
+    {
+        OS_FileSystem_CallStats_t ops[OS_FileSystem_StatsOp_MAX];
+        OS_FileSystem_CallStats_t storage[OS_FileSystem_StatsStorage_MAX];
+    } stats;
+#endif
+#if defined(OS_FILESYSTEM_WITH_TRACE)
+    Trace_t trace;
+#endif
 };
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#pragma once
+
+#include "OS_FileSystem.h"
+#include "OS_FileSystem_ext.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Bounded queue of asynchronous file requests. Requests are executed in the
+ * order of their submission by AsyncQueue_process(), which runs them through
+ * the file operations of the backend.
+ *
+ * Results of requests without a callback stay in their slot until they are
+ * polled or the file of the request is closed.
+ */
+
+typedef enum
+{
+    AsyncQueue_Op_READ,
+    AsyncQueue_Op_WRITE,
+    AsyncQueue_Op_SYNC,
+} AsyncQueue_Op_t;
+
+typedef struct
+{
+    AsyncQueue_Op_t op;
+    OS_FileSystemFile_Handle_t hFile;
+    off_t offset;
+    OS_FileSystemFile_IoVec_t iov;
+    OS_FileSystem_AsyncCallback_t callback;
+    void* ctx;
+    // Managed by the queue
+    uint16_t generation;
+    uint8_t state;
+    OS_Error_t result;
+} AsyncQueue_Request_t;
+
+typedef struct
+{
+    size_t size;
+    AsyncQueue_Request_t* requests;
+    uint16_t* fifo;         // Queued requests in the order of submission
+    size_t head;
+    size_t queued;
+    uint16_t* freeSlots;    // Stack of unused requests
+    size_t free;
+} AsyncQueue_t;
+
+OS_Error_t
+AsyncQueue_init(
+    OS_FileSystem_Handle_t self);
+
+void
+AsyncQueue_free(
+    OS_FileSystem_Handle_t self);
+
+bool
+AsyncQueue_isEnabled(
+    OS_FileSystem_Handle_t self);
+
+OS_Error_t
+AsyncQueue_submit(
+    OS_FileSystem_Handle_t      self,
+    const AsyncQueue_Request_t* request,
+    OS_FileSystem_AsyncToken_t* token);
+
+OS_Error_t
+AsyncQueue_process(
+    OS_FileSystem_Handle_t self,
+    size_t                 maxRequests,
+    size_t*                processed);
+
+OS_Error_t
+AsyncQueue_poll(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystem_AsyncToken_t token,
+    OS_Error_t*                result);
+
+void
+AsyncQueue_releaseFile(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile);
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#pragma once
+
+#include "OS_FileSystem.h"
+#include "OS_FileSystem_ext.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Write-back LRU cache of fixed-size blocks on top of a byte-addressed
+ * storage. Transfers which span several uncached blocks bypass the cache, so
+ * bulk data does not evict the (meta-)data which is accessed repeatedly.
+ *
+ * The storage sees the writes in the order they were made: dirty blocks are
+ * written back in the order they were dirtied, and blocks dirtied earlier are
+ * written back before a block is written again, before anything else goes to
+ * the storage and before a range is discarded for an erase. The power-loss
+ * safety of LittleFS and SPIFFS relies on this order.
+ */
+
+typedef struct
+{
+    OS_Error_t (*read)(void* ctx, off_t addr, size_t size, void* buffer);
+    OS_Error_t (*write)(void* ctx, off_t addr, size_t size, const void* buffer);
+    void* ctx;
+} BlockCache_Storage_t;
+
+typedef struct
+{
+    off_t addr;         // Address of the cached block, -1 if unused
+    size_t dirtyFrom;   // Dirty range within the block, empty if clean
+    size_t dirtyTo;
+    uint64_t seq;       // When the block was dirtied, zero if clean
+    uint32_t prev;      // LRU list
+    uint32_t next;
+    uint32_t chain;     // Hash chain
+} BlockCache_Entry_t;
+
+typedef struct
+{
+    BlockCache_Storage_t storage;
+    size_t blockSize;
+    uint32_t blockCount;
+    uint32_t bucketMask;
+    uint8_t* data;
+    BlockCache_Entry_t* entries;
+    uint32_t* buckets;
+    uint64_t* order;    // Scratch space for sorting dirty blocks
+    uint64_t seq;       // Sequence number of the block dirtied last
+    uint32_t lruHead;   // Most recently used entry
+    uint32_t lruTail;   // Least recently used entry, the next victim
+    OS_FileSystem_CacheStats_t stats;
+} BlockCache_t;
+
+OS_Error_t
+BlockCache_init(
+    BlockCache_t*               self,
+    size_t                      blockSize,
+    size_t                      blockCount,
+    const BlockCache_Storage_t* storage);
+
+void
+BlockCache_free(
+    BlockCache_t* self);
+
+OS_Error_t
+BlockCache_read(
+    BlockCache_t* self,
+    off_t         addr,
+    size_t        size,
+    void*         buffer);
+
+OS_Error_t
+BlockCache_write(
+    BlockCache_t* self,
+    off_t         addr,
+    size_t        size,
+    const void*   buffer);
+
+OS_Error_t
+BlockCache_discard(
+    BlockCache_t* self,
+    off_t         addr,
+    off_t         size);
+
+OS_Error_t
+BlockCache_flush(
+    BlockCache_t* self);
@@ -27,4 +27,8 @@ FatFs_mount(
 
 OS_Error_t
 FatFs_unmount(
+    OS_FileSystem_Handle_t self);
+
+OS_Error_t
+FatFs_wipe(
     OS_FileSystem_Handle_t self);
\ No newline at end of file
@@ -9,6 +9,9 @@
 #pragma once
 
 #include "OS_FileSystem.h"
+#include "OS_FileSystem_ext.h"
+
+#include "lib/NameCache.h"
 
 OS_Error_t
 FatFsFile_open(
@@ -24,20 +27,25 @@ FatFsFile_close(
     OS_FileSystemFile_Handle_t hFile);
 
 OS_Error_t
-FatFsFile_read(
-    OS_FileSystem_Handle_t     self,
-    OS_FileSystemFile_Handle_t hFile,
-    const off_t                offset,
-    const size_t               len,
-    void*                      buffer);
+FatFsFile_readv(
+    OS_FileSystem_Handle_t           self,
+    OS_FileSystemFile_Handle_t       hFile,
+    const off_t                      offset,
+    const OS_FileSystemFile_IoVec_t* iov,
+    const size_t                     iovCount);
 
 OS_Error_t
-FatFsFile_write(
+FatFsFile_writev(
+    OS_FileSystem_Handle_t           self,
+    OS_FileSystemFile_Handle_t       hFile,
+    const off_t                      offset,
+    const OS_FileSystemFile_IoVec_t* iov,
+    const size_t                     iovCount);
+
+OS_Error_t
+FatFsFile_sync(
     OS_FileSystem_Handle_t     self,
-    OS_FileSystemFile_Handle_t hFile,
-    const off_t                offset,
-    const size_t               len,
-    const void*                buffer);
+    OS_FileSystemFile_Handle_t hFile);
 
 OS_Error_t
 FatFsFile_delete(
@@ -49,3 +57,28 @@ FatFsFile_getSize(
     OS_FileSystem_Handle_t self,
     const char*            name,
     off_t*                 sz);
+
+OS_Error_t
+FatFsFile_getSizeByHandle(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile,
+    off_t*                     sz);
+
+OS_Error_t
+FatFsFile_openById(
+    OS_FileSystem_Handle_t         self,
+    OS_FileSystemFile_Handle_t     hFile,
+    const NameCache_Id_t*          id,
+    const OS_FileSystem_OpenMode_t mode);
+
+OS_Error_t
+FatFsFile_getId(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile,
+    NameCache_Id_t*            id);
+
+OS_Error_t
+FatFsFile_getSizeById(
+    OS_FileSystem_Handle_t self,
+    const NameCache_Id_t*  id,
+    off_t*                 sz);
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#pragma once
+
+#include "OS_FileSystem.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Two-level bitmap of handles. Each bit of the second level tells whether the
+ * corresponding word of the first level is full, so a free handle is found with
+ * two bit-scans as long as there are no more than 64 * 64 handles.
+ */
+
+typedef struct
+{
+    size_t count;       // Number of handles
+    size_t words;       // Number of words in the first level
+    uint64_t* used;     // One bit per handle, set if the handle is in use
+    uint64_t* full;     // One bit per word of used, set if it has no free bit
+} HandleBitmap_t;
+
+OS_Error_t
+HandleBitmap_init(
+    HandleBitmap_t* self,
+    size_t          count);
+
+void
+HandleBitmap_free(
+    HandleBitmap_t* self);
+
+// Returns the lowest free handle or the number of handles if all are in use
+size_t
+HandleBitmap_take(
+    HandleBitmap_t* self);
+
+void
+HandleBitmap_release(
+    HandleBitmap_t* self,
+    size_t          handle);
+
+bool
+HandleBitmap_inUse(
+    const HandleBitmap_t* self,
+    size_t                handle);
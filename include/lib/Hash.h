@@ -0,0 +1,16 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// FNV-1a hash of a file name, for the tables which are looked up by name
+uint32_t
+Hash_name(
+    const char* name);
@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#pragma once
+
+#include "OS_FileSystem.h"
+
+/*
+ * Error of a failed storage access, kept for the calling thread. The storage
+ * callbacks of the backends record errors here and the code calling into the
+ * backends picks them up when a backend call fails, to return the actual cause
+ * instead of a generic error.
+ *
+ * Since the error belongs to the thread, concurrent operations do not see each
+ * other's errors; successful accesses do not record anything. Not every failed
+ * access is picked up, so each operation of the file system clears the error
+ * when it starts and sees only the errors of its own accesses.
+ */
+
+void
+IoError_set(
+    OS_Error_t err);
+
+void
+IoError_clear(void);
+
+// Returns the recorded error, or the fallback if there is none, and clears it
+OS_Error_t
+IoError_get(
+    OS_Error_t fallback);
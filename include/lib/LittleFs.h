@@ -28,4 +28,8 @@ LittleFs_mount(
 
 OS_Error_t
 LittleFs_unmount(
+    OS_FileSystem_Handle_t self);
+
+OS_Error_t
+LittleFs_wipe(
     OS_FileSystem_Handle_t self);
\ No newline at end of file
@@ -9,6 +9,7 @@
 #pragma once
 
 #include "OS_FileSystem.h"
+#include "OS_FileSystem_ext.h"
 
 OS_Error_t
 LittleFsFile_open(
@@ -24,20 +25,25 @@ LittleFsFile_close(
     OS_FileSystemFile_Handle_t hFile);
 
 OS_Error_t
-LittleFsFile_read(
-    OS_FileSystem_Handle_t     self,
-    OS_FileSystemFile_Handle_t hFile,
-    const off_t                offset,
-    const size_t               len,
-    void*                      buffer);
+LittleFsFile_readv(
+    OS_FileSystem_Handle_t           self,
+    OS_FileSystemFile_Handle_t       hFile,
+    const off_t                      offset,
+    const OS_FileSystemFile_IoVec_t* iov,
+    const size_t                     iovCount);
 
 OS_Error_t
-LittleFsFile_write(
+LittleFsFile_writev(
+    OS_FileSystem_Handle_t           self,
+    OS_FileSystemFile_Handle_t       hFile,
+    const off_t                      offset,
+    const OS_FileSystemFile_IoVec_t* iov,
+    const size_t                     iovCount);
+
+OS_Error_t
+LittleFsFile_sync(
     OS_FileSystem_Handle_t     self,
-    OS_FileSystemFile_Handle_t hFile,
-    const off_t                offset,
-    const size_t               len,
-    const void*                buffer);
+    OS_FileSystemFile_Handle_t hFile);
 
 OS_Error_t
 LittleFsFile_delete(
@@ -49,3 +55,9 @@ LittleFsFile_getSize(
     OS_FileSystem_Handle_t self,
     const char*            name,
     off_t*                 sz);
+
+OS_Error_t
+LittleFsFile_getSizeByHandle(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile,
+    off_t*                     sz);
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#pragma once
+
+#include "OS_FileSystem.h"
+#include "OS_FileSystem_ext.h"
+
+#include <stdbool.h>
+
+/*
+ * Locks of a file system instance, created through the callbacks of the
+ * extended configuration. If locking is not enabled, all locks are NULL and
+ * acquiring or releasing them does nothing.
+ */
+
+typedef struct
+{
+    void* instance;     // Shared for file I/O, exclusive for everything else
+    void* backend;      // State of the backend, storage and block cache
+    void* queue;        // Queue of asynchronous requests
+    void** files;       // One for each open file
+} Lock_t;
+
+OS_Error_t
+Lock_init(
+    OS_FileSystem_Handle_t self);
+
+void
+Lock_free(
+    OS_FileSystem_Handle_t self);
+
+OS_Error_t
+Lock_createFile(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile);
+
+void
+Lock_destroyFile(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile);
+
+OS_Error_t
+Lock_acquire(
+    OS_FileSystem_Handle_t self,
+    void*                  lock,
+    bool                   exclusive);
+
+void
+Lock_release(
+    OS_FileSystem_Handle_t self,
+    void*                  lock,
+    bool                   exclusive);
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#pragma once
+
+#include "OS_FileSystem.h"
+#include "OS_FileSystem_ext.h"
+
+#include "ff.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Cache of the names the backends have looked up. An entry either holds the
+ * identity of the file in the backend, by which the backend can find the file
+ * again without looking up its name, or notes that there is no file of that
+ * name. The entries are kept in sets of NameCache_WAYS, the least recently
+ * used entry of a set is replaced.
+ */
+
+/*
+ * Maximum length of a cached name, including the terminating zero. Longer
+ * names are always looked up by the backend.
+ */
+#if !defined(OS_FILESYSTEM_NAME_CACHE_NAME_LEN)
+#define OS_FILESYSTEM_NAME_CACHE_NAME_LEN   48
+#endif
+
+#define NameCache_WAYS  4
+
+// Identity of a file, for the backends which can open a file by it
+typedef union
+{
+    FFLOC fatFs;
+} NameCache_Id_t;
+
+typedef enum
+{
+    NameCache_State_UNKNOWN,    // The name is not in the cache
+    NameCache_State_FOUND,      // The file was found, its identity is known
+    NameCache_State_MISSING,    // There is no file of the name
+} NameCache_State_t;
+
+typedef struct
+{
+    char name[OS_FILESYSTEM_NAME_CACHE_NAME_LEN];   // Empty if unused
+    uint32_t hash;
+    uint32_t used;      // Time of the last use
+    bool found;
+    NameCache_Id_t id;
+} NameCache_Entry_t;
+
+typedef struct
+{
+    NameCache_Entry_t* entries;
+    size_t sets;        // Number of sets, zero if disabled
+    uint32_t clock;     // Counts the uses of entries
+} NameCache_t;
+
+OS_Error_t
+NameCache_init(
+    OS_FileSystem_Handle_t self);
+
+void
+NameCache_free(
+    OS_FileSystem_Handle_t self);
+
+bool
+NameCache_isEnabled(
+    OS_FileSystem_Handle_t self);
+
+NameCache_State_t
+NameCache_lookup(
+    OS_FileSystem_Handle_t self,
+    const char*            name,
+    NameCache_Id_t*        id);
+
+// Note the identity of the file of a name, or that there is none if id is NULL
+void
+NameCache_insert(
+    OS_FileSystem_Handle_t self,
+    const char*            name,
+    const NameCache_Id_t*  id);
+
+void
+NameCache_remove(
+    OS_FileSystem_Handle_t self,
+    const char*            name);
+
+// Note that a file was created, with its identity if it is known
+void
+NameCache_create(
+    OS_FileSystem_Handle_t self,
+    const char*            name,
+    const NameCache_Id_t*  id);
+
+void
+NameCache_clear(
+    OS_FileSystem_Handle_t self);
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#pragma once
+
+#include "OS_FileSystem.h"
+#include "OS_FileSystem_ext.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Read-ahead for files which are read sequentially. The file layer tracks the
+ * access pattern of each open file and sets a read-ahead window for the
+ * calling thread while it reads from a sequential file; the storage layer
+ * extends its reads up to that window and keeps the data in a buffer, from
+ * which the following reads are served.
+ */
+
+typedef struct
+{
+    off_t next;         // Offset behind the previous read, -1 if unknown
+    size_t window;      // Read-ahead window, zero if not read sequentially
+    uint8_t hint;       // Access pattern given when the file was opened
+} ReadAhead_File_t;
+
+typedef struct
+{
+    uint8_t* buffer;
+    size_t size;        // Size of the buffer, zero if disabled
+    off_t addr;         // Storage range held in the buffer
+    size_t len;
+    ReadAhead_File_t* files;
+} ReadAhead_t;
+
+typedef OS_Error_t (*ReadAhead_Read_t)(
+    OS_FileSystem_Handle_t self,
+    off_t                  addr,
+    size_t                 size,
+    void*                  buffer);
+
+OS_Error_t
+ReadAhead_init(
+    OS_FileSystem_Handle_t self);
+
+void
+ReadAhead_free(
+    OS_FileSystem_Handle_t self);
+
+void
+ReadAhead_open(
+    OS_FileSystem_Handle_t          self,
+    OS_FileSystemFile_Handle_t      hFile,
+    const OS_FileSystem_OpenFlags_t flags);
+
+// Set the window of the calling thread for a read of the file at the offset
+void
+ReadAhead_begin(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile,
+    const off_t                offset);
+
+// Note the end of a read of the file and clear the window of the calling thread
+void
+ReadAhead_end(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile,
+    const off_t                offset,
+    const size_t               len,
+    const OS_Error_t           err);
+
+// Read from the storage through the buffer, if the calling thread has a window
+OS_Error_t
+ReadAhead_read(
+    OS_FileSystem_Handle_t self,
+    off_t                  addr,
+    size_t                 size,
+    void*                  buffer,
+    ReadAhead_Read_t       read);
+
+void
+ReadAhead_invalidate(
+    OS_FileSystem_Handle_t self,
+    const off_t            addr,
+    const off_t            size);
+
+// Forget the access patterns of all files and the data in the buffer
+void
+ReadAhead_reset(
+    OS_FileSystem_Handle_t self);
@@ -28,4 +28,8 @@ SpifFs_mount(
 
 OS_Error_t
 SpifFs_unmount(
+    OS_FileSystem_Handle_t self);
+
+OS_Error_t
+SpifFs_wipe(
     OS_FileSystem_Handle_t self);
\ No newline at end of file
@@ -9,6 +9,7 @@
 #pragma once
 
 #include "OS_FileSystem.h"
+#include "OS_FileSystem_ext.h"
 
 OS_Error_t
 SpifFsFile_open(
@@ -24,20 +25,25 @@ SpifFsFile_close(
     OS_FileSystemFile_Handle_t hFile);
 
 OS_Error_t
-SpifFsFile_read(
-    OS_FileSystem_Handle_t     self,
-    OS_FileSystemFile_Handle_t hFile,
-    const off_t                offset,
-    const size_t               len,
-    void*                      buffer);
+SpifFsFile_readv(
+    OS_FileSystem_Handle_t           self,
+    OS_FileSystemFile_Handle_t       hFile,
+    const off_t                      offset,
+    const OS_FileSystemFile_IoVec_t* iov,
+    const size_t                     iovCount);
 
 OS_Error_t
-SpifFsFile_write(
+SpifFsFile_writev(
+    OS_FileSystem_Handle_t           self,
+    OS_FileSystemFile_Handle_t       hFile,
+    const off_t                      offset,
+    const OS_FileSystemFile_IoVec_t* iov,
+    const size_t                     iovCount);
+
+OS_Error_t
+SpifFsFile_sync(
     OS_FileSystem_Handle_t     self,
-    OS_FileSystemFile_Handle_t hFile,
-    const off_t                offset,
-    const size_t               len,
-    const void*                buffer);
+    OS_FileSystemFile_Handle_t hFile);
 
 OS_Error_t
 SpifFsFile_delete(
@@ -49,3 +55,9 @@ SpifFsFile_getSize(
     OS_FileSystem_Handle_t self,
     const char*            name,
     off_t*                 sz);
+
+OS_Error_t
+SpifFsFile_getSizeByHandle(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile,
+    off_t*                     sz);
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#pragma once
+
+#include "OS_FileSystem.h"
+
+#include "spiffs.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Index of all files of a mounted SPIFFS, which maps the name of a file to its
+ * object id and the page of its index header. SPIFFS itself finds a file by
+ * scanning the object lookup pages and reading the index header of every file
+ * on the flash; with the index a file is opened directly by its page and names
+ * which are not in the index do not exist.
+ *
+ * The page is only a hint, since SPIFFS moves the index header when a file is
+ * written or garbage is collected; whoever opens a file by its page checks the
+ * object id and notes the new page. The index is built when the file system is
+ * mounted and dropped if it cannot be kept complete.
+ */
+
+typedef struct SpifFsIndex_Entry
+{
+    struct SpifFsIndex_Entry* next;
+    spiffs_obj_id objId;
+    spiffs_page_ix pix;     // Index header page, may be outdated
+    char name[SPIFFS_OBJ_NAME_LEN];
+} SpifFsIndex_Entry_t;
+
+typedef struct
+{
+    SpifFsIndex_Entry_t** buckets;
+    size_t bucketCount;     // Zero if there is no index
+    size_t count;
+} SpifFsIndex_t;
+
+OS_Error_t
+SpifFsIndex_build(
+    OS_FileSystem_Handle_t self);
+
+void
+SpifFsIndex_clear(
+    OS_FileSystem_Handle_t self);
+
+bool
+SpifFsIndex_isValid(
+    OS_FileSystem_Handle_t self);
+
+// Returns NULL if there is no file of the name
+const SpifFsIndex_Entry_t*
+SpifFsIndex_find(
+    OS_FileSystem_Handle_t self,
+    const char*            name);
+
+// Note the object id and index header page of a file, adding it if it is new
+void
+SpifFsIndex_update(
+    OS_FileSystem_Handle_t self,
+    const spiffs_stat*     stat);
+
+void
+SpifFsIndex_remove(
+    OS_FileSystem_Handle_t self,
+    const char*            name);
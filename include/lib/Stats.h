@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#pragma once
+
+#include "OS_FileSystem.h"
+#include "OS_FileSystem_ext.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Collection of statistics. Without OS_FILESYSTEM_WITH_STATISTICS, the macros
+ * expand to nothing, so the instrumentation does not cost anything.
+ *
+ * STATS_START() takes the start time of a call and has to be placed in the
+ * same scope before STATS_OP() or STATS_STORAGE() record the call.
+ */
+
+#if defined(OS_FILESYSTEM_WITH_STATISTICS)
+
+uint64_t
+Stats_now(
+    OS_FileSystem_Handle_t self);
+
+void
+Stats_record(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystem_CallStats_t* stats,
+    uint64_t                   start,
+    size_t                     bytes,
+    OS_Error_t                 err);
+
+#define STATS_START(self) \
+    const uint64_t statsStart = Stats_now(self)
+#define STATS_OP(self, op, bytes, err) \
+    Stats_record(self, &(self)->stats.ops[OS_FileSystem_StatsOp_ ## op], \
+                 statsStart, bytes, err)
+#define STATS_STORAGE(self, call, bytes, err) \
+    Stats_record(self, \
+                 &(self)->stats.storage[OS_FileSystem_StatsStorage_ ## call], \
+                 statsStart, bytes, err)
+
+#else
+
+#define STATS_START(self)
+#define STATS_OP(self, op, bytes, err)
+#define STATS_STORAGE(self, call, bytes, err)
+
+#endif
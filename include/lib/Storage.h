@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#pragma once
+
+#include "OS_FileSystem.h"
+#include "OS_FileSystem_ext.h"
+
+/*
+ * Access to the storage for the file system backends: Transfers are moved
+ * through the dataport (split up if necessary) and pass the block cache, if
+ * one is configured.
+ */
+
+OS_Error_t
+Storage_init(
+    OS_FileSystem_Handle_t self);
+
+OS_Error_t
+Storage_free(
+    OS_FileSystem_Handle_t self);
+
+OS_Error_t
+Storage_read(
+    OS_FileSystem_Handle_t self,
+    off_t                  addr,
+    size_t                 size,
+    void*                  buffer);
+
+OS_Error_t
+Storage_write(
+    OS_FileSystem_Handle_t self,
+    off_t                  addr,
+    size_t                 size,
+    const void*            buffer);
+
+/*
+ * Erases are held back and joined with adjacent ones until the range is
+ * accessed or the storage is flushed; an error of the erase is returned then.
+ */
+OS_Error_t
+Storage_erase(
+    OS_FileSystem_Handle_t self,
+    off_t                  addr,
+    off_t                  size);
+
+/*
+ * Erase the whole storage with as few calls as possible, each covering a run of
+ * erase blocks of the given size. Blocks which are known to be erased since the
+ * previous wipe are skipped.
+ */
+OS_Error_t
+Storage_wipe(
+    OS_FileSystem_Handle_t self,
+    off_t                  blockSize);
+
+OS_Error_t
+Storage_flush(
+    OS_FileSystem_Handle_t self);
+
+/*
+ * While flushes are deferred for the calling thread, Storage_flush() does
+ * nothing. This lets the syncs of several files share a single flush.
+ */
+void
+Storage_deferFlush(
+    bool defer);
+
+bool
+Storage_isCached(
+    OS_FileSystem_Handle_t self);
+
+/*
+ * Tells if transfers may be split up or served from elsewhere below the
+ * backends, with the dataport being used for other parts of the request in the
+ * meantime. A backend buffer cannot be placed in the dataport then.
+ */
+bool
+Storage_sharesDataport(
+    OS_FileSystem_Handle_t self);
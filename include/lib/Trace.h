@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#pragma once
+
+#include "OS_FileSystem.h"
+#include "OS_FileSystem_ext.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Trace of the storage calls. Without OS_FILESYSTEM_WITH_TRACE, the macros
+ * expand to nothing.
+ *
+ * TRACE_OP() notes the operation the calling thread is about to perform, so
+ * the storage calls it causes can be attributed to it. TRACE_START() takes the
+ * start time of a storage call and has to be placed in the same scope before
+ * TRACE_STORAGE() records the call.
+ */
+
+typedef struct
+{
+    OS_FileSystem_TraceEntry_t* buffer;
+    uint32_t entries;
+    uint32_t next;      // Sequence number of the next entry
+} Trace_t;
+
+#if defined(OS_FILESYSTEM_WITH_TRACE)
+
+OS_Error_t
+Trace_init(
+    OS_FileSystem_Handle_t self);
+
+void
+Trace_setOp(
+    OS_FileSystem_StatsOp_t op);
+
+uint64_t
+Trace_now(
+    OS_FileSystem_Handle_t self);
+
+void
+Trace_record(
+    OS_FileSystem_Handle_t       self,
+    OS_FileSystem_StatsStorage_t call,
+    off_t                        addr,
+    size_t                       size,
+    uint64_t                     start,
+    OS_Error_t                   err);
+
+#define TRACE_OP(op) \
+    Trace_setOp(OS_FileSystem_StatsOp_ ## op)
+#define TRACE_START(self) \
+    const uint64_t traceStart = Trace_now(self)
+#define TRACE_STORAGE(self, call, addr, size, err) \
+    Trace_record(self, OS_FileSystem_StatsStorage_ ## call, addr, size, \
+                 traceStart, err)
+
+#else
+
+#define Trace_init(self) OS_SUCCESS
+#define TRACE_OP(op)
+#define TRACE_START(self)
+#define TRACE_STORAGE(self, call, addr, size, err)
+
+#endif
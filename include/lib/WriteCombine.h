@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#pragma once
+
+#include "OS_FileSystem.h"
+#include "OS_FileSystem_ext.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Buffers which combine small writes to an open file into larger ones. Writes
+ * which continue the buffered data are appended to it; the buffer is written
+ * to the file when it is full, when a write does not continue it, and before
+ * the file is read, synced or closed. If writing the buffer fails, the error
+ * is returned once and the buffered data is dropped.
+ */
+
+typedef struct
+{
+    uint8_t* data;      // Allocated with the first buffered write
+    off_t offset;       // Offset of the data in the file, or the current one
+    size_t len;
+    uint64_t since;     // Time the first byte was buffered
+    bool readOnly;      // Writes go to the backend, which refuses them
+} WriteCombine_File_t;
+
+typedef struct
+{
+    size_t size;        // Size of a buffer, zero if disabled
+    WriteCombine_File_t* files;
+} WriteCombine_t;
+
+OS_Error_t
+WriteCombine_init(
+    OS_FileSystem_Handle_t self);
+
+void
+WriteCombine_free(
+    OS_FileSystem_Handle_t self);
+
+// Write to a file, either into its buffer or through to the backend
+OS_Error_t
+WriteCombine_write(
+    OS_FileSystem_Handle_t           self,
+    OS_FileSystemFile_Handle_t       hFile,
+    const off_t                      offset,
+    const OS_FileSystemFile_IoVec_t* iov,
+    const size_t                     iovCount);
+
+OS_Error_t
+WriteCombine_flush(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile);
+
+OS_Error_t
+WriteCombine_flushAll(
+    OS_FileSystem_Handle_t self);
+
+// Set up the state of a file which was opened
+void
+WriteCombine_open(
+    OS_FileSystem_Handle_t         self,
+    OS_FileSystemFile_Handle_t     hFile,
+    const OS_FileSystem_OpenMode_t mode);
+
+// Drop the buffer of a file which was closed
+void
+WriteCombine_close(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile);
@@ -7,8 +7,19 @@
  */
 
 #include "OS_FileSystem.h"
+#include "OS_FileSystem_ext.h"
 #include "OS_FileSystem_int.h"
 
+#include "lib/AsyncQueue.h"
+#include "lib/IoError.h"
+#include "lib/Lock.h"
+#include "lib/NameCache.h"
+#include "lib/ReadAhead.h"
+#include "lib/Stats.h"
+#include "lib/Trace.h"
+#include "lib/WriteCombine.h"
+#include "lib/Storage.h"
+
 #include "lib/LittleFs.h"
 #include "lib/LittleFsFile.h"
 #include "lib/FatFs.h"
@@ -35,15 +46,19 @@ static const OS_FileSystem_FsOps_t littleFs_ops =
     .format     = LittleFs_format,
     .mount      = LittleFs_mount,
     .unmount    = LittleFs_unmount,
+    .wipe       = LittleFs_wipe,
 };
 static const OS_FileSystem_FileOps_t littleFsFile_ops =
 {
-    .open       = LittleFsFile_open,
-    .close      = LittleFsFile_close,
-    .read       = LittleFsFile_read,
-    .write      = LittleFsFile_write,
-    .delete     = LittleFsFile_delete,
-    .getSize    = LittleFsFile_getSize,
+    .fileSize        = sizeof(LittleFs_File_t),
+    .open            = LittleFsFile_open,
+    .close           = LittleFsFile_close,
+    .readv           = LittleFsFile_readv,
+    .writev          = LittleFsFile_writev,
+    .sync            = LittleFsFile_sync,
+    .delete          = LittleFsFile_delete,
+    .getSize         = LittleFsFile_getSize,
+    .getSizeByHandle = LittleFsFile_getSizeByHandle,
 };
 
 // FatFs callbacks
@@ -54,15 +69,23 @@ static const OS_FileSystem_FsOps_t fatFs_ops =
     .format     = FatFs_format,
     .mount      = FatFs_mount,
     .unmount    = FatFs_unmount,
+    .wipe       = FatFs_wipe,
 };
 static const OS_FileSystem_FileOps_t fatFsFile_ops =
 {
-    .open       = FatFsFile_open,
-    .close      = FatFsFile_close,
-    .read       = FatFsFile_read,
-    .write      = FatFsFile_write,
-    .delete     = FatFsFile_delete,
-    .getSize    = FatFsFile_getSize,
+    .fileSize        = sizeof(FatFs_File_t),
+    .selfLocking     = true,
+    .open            = FatFsFile_open,
+    .close           = FatFsFile_close,
+    .readv           = FatFsFile_readv,
+    .writev          = FatFsFile_writev,
+    .sync            = FatFsFile_sync,
+    .delete          = FatFsFile_delete,
+    .getSize         = FatFsFile_getSize,
+    .getSizeByHandle = FatFsFile_getSizeByHandle,
+    .getId           = FatFsFile_getId,
+    .openById        = FatFsFile_openById,
+    .getSizeById     = FatFsFile_getSizeById,
 };
 
 // SpifFs callbacks
@@ -73,15 +96,19 @@ static const OS_FileSystem_FsOps_t spifFs_ops =
     .format     = SpifFs_format,
     .mount      = SpifFs_mount,
     .unmount    = SpifFs_unmount,
+    .wipe       = SpifFs_wipe,
 };
 static const OS_FileSystem_FileOps_t spifFsFile_ops =
 {
-    .open       = SpifFsFile_open,
-    .close      = SpifFsFile_close,
-    .read       = SpifFsFile_read,
-    .write      = SpifFsFile_write,
-    .delete     = SpifFsFile_delete,
-    .getSize    = SpifFsFile_getSize,
+    .fileSize        = sizeof(spiffs_file),
+    .open            = SpifFsFile_open,
+    .close           = SpifFsFile_close,
+    .readv           = SpifFsFile_readv,
+    .writev          = SpifFsFile_writev,
+    .sync            = SpifFsFile_sync,
+    .delete          = SpifFsFile_delete,
+    .getSize         = SpifFsFile_getSize,
+    .getSizeByHandle = SpifFsFile_getSizeByHandle,
 };
 
 // Private Functions -----------------------------------------------------------
@@ -109,6 +136,28 @@ isInitParametersOk(
     return true;
 }
 
+// Wiping the storage under a mounted file system or an open file would leave
+// them with state which no longer matches the storage
+static bool
+isUnused(
+    OS_FileSystem_Handle_t self)
+{
+    if (self->mounted)
+    {
+        Debug_LOG_ERROR("File system is mounted");
+        return false;
+    }
+    for (size_t i = 0; i < self->handles.count; i++)
+    {
+        if (HandleBitmap_inUse(&self->handles, i))
+        {
+            Debug_LOG_ERROR("File handle %zu is in use", i);
+            return false;
+        }
+    }
+    return true;
+}
+
 
 // Public Functions ------------------------------------------------------------
 
@@ -116,6 +165,15 @@ OS_Error_t
 OS_FileSystem_init(
     OS_FileSystem_Handle_t*       self,
     const OS_FileSystem_Config_t* cfg)
+{
+    return OS_FileSystem_initExt(self, cfg, NULL);
+}
+
+OS_Error_t
+OS_FileSystem_initExt(
+    OS_FileSystem_Handle_t*          self,
+    const OS_FileSystem_Config_t*    cfg,
+    const OS_FileSystem_ExtConfig_t* extCfg)
 {
     OS_Error_t err;
     OS_FileSystem_Handle_t fs;
@@ -139,6 +197,10 @@ OS_FileSystem_init(
     }
 
     fs->cfg = *cfg;
+    if (NULL != extCfg)
+    {
+        fs->extCfg = *extCfg;
+    }
 
     // Check if a user passed a size; if it is zero, we just max out the
     // underlying storage. If it is non-zero, we need to check if it would fit.
@@ -181,10 +243,83 @@ OS_FileSystem_init(
         goto err0;
     }
 
+    if ((err = HandleBitmap_init(&fs->handles,
+                                 (0 == fs->extCfg.fileHandles) ?
+                                 DEFAULT_FILE_HANDLES :
+                                 fs->extCfg.fileHandles)) != OS_SUCCESS)
+    {
+        goto err0;
+    }
+
+    fs->files = calloc(fs->handles.count, sizeof(void*));
+    fs->names = calloc(fs->handles.count, sizeof(char*));
+    if (NULL == fs->files || NULL == fs->names)
+    {
+        err = OS_ERROR_INSUFFICIENT_SPACE;
+        goto err1;
+    }
+
+    if ((err = Storage_init(fs)) != OS_SUCCESS)
+    {
+        goto err2;
+    }
+
+    if ((err = AsyncQueue_init(fs)) != OS_SUCCESS)
+    {
+        goto err3;
+    }
+
+    if ((err = Lock_init(fs)) != OS_SUCCESS)
+    {
+        goto err4;
+    }
+
+    if ((err = Trace_init(fs)) != OS_SUCCESS)
+    {
+        goto err5;
+    }
+
+    if ((err = ReadAhead_init(fs)) != OS_SUCCESS)
+    {
+        goto err5;
+    }
+
+    if ((err = WriteCombine_init(fs)) != OS_SUCCESS)
+    {
+        goto err6;
+    }
+
+    if ((err = NameCache_init(fs)) != OS_SUCCESS)
+    {
+        goto err7;
+    }
+
+    if ((err = fs->fsOps->init(fs)) != OS_SUCCESS)
+    {
+        goto err8;
+    }
+
     *self = fs;
 
-    return fs->fsOps->init(fs);
+    return OS_SUCCESS;
 
+err8:
+    NameCache_free(fs);
+err7:
+    WriteCombine_free(fs);
+err6:
+    ReadAhead_free(fs);
+err5:
+    Lock_free(fs);
+err4:
+    AsyncQueue_free(fs);
+err3:
+    Storage_free(fs);
+err2:
+    free(fs->files);
+    free(fs->names);
+err1:
+    HandleBitmap_free(&fs->handles);
 err0:
     free(fs);
     return err;
@@ -201,7 +336,24 @@ OS_FileSystem_free(
         return OS_ERROR_INVALID_PARAMETER;
     }
 
+    // Requests still queued are dropped along with the queue
     err = self->fsOps->free(self);
+    AsyncQueue_free(self);
+    WriteCombine_free(self);
+    NameCache_free(self);
+    Lock_free(self);
+    ReadAhead_free(self);
+    Storage_free(self);
+
+    // Release the state of files which have not been closed
+    for (size_t i = 0; i < self->handles.count; i++)
+    {
+        free(self->files[i]);
+        free(self->names[i]);
+    }
+    free(self->files);
+    free(self->names);
+    HandleBitmap_free(&self->handles);
     free(self);
 
     return err;
@@ -211,25 +363,326 @@ OS_Error_t
 OS_FileSystem_format(
     OS_FileSystem_Handle_t self)
 {
-    return (NULL == self) ?
-           OS_ERROR_INVALID_PARAMETER :
-           self->fsOps->format(self);
+    OS_Error_t err;
+
+    if (NULL == self)
+    {
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+
+    STATS_START(self);
+    TRACE_OP(FORMAT);
+    IoError_clear();
+
+    if ((err = Lock_acquire(self, self->lock.instance, true)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    NameCache_clear(self);
+
+    if ((err = self->fsOps->format(self)) == OS_SUCCESS)
+    {
+        err = Storage_flush(self);
+    }
+
+    Lock_release(self, self->lock.instance, true);
+
+    STATS_OP(self, FORMAT, 0, err);
+
+    return err;
 }
 
 OS_Error_t
 OS_FileSystem_mount(
     OS_FileSystem_Handle_t self)
 {
-    return (NULL == self) ?
-           OS_ERROR_INVALID_PARAMETER :
-           self->fsOps->mount(self);
+    OS_Error_t err;
+
+    if (NULL == self)
+    {
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+
+    STATS_START(self);
+    TRACE_OP(MOUNT);
+    IoError_clear();
+
+    if ((err = Lock_acquire(self, self->lock.instance, true)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    NameCache_clear(self);
+
+    if ((err = self->fsOps->mount(self)) == OS_SUCCESS)
+    {
+        self->mounted = true;
+    }
+
+    Lock_release(self, self->lock.instance, true);
+
+    STATS_OP(self, MOUNT, 0, err);
+
+    return err;
 }
 
 OS_Error_t
 OS_FileSystem_unmount(
     OS_FileSystem_Handle_t self)
 {
+    OS_Error_t err;
+
+    if (NULL == self)
+    {
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+
+    STATS_START(self);
+
+    // Queued requests note their own operation for the trace, so ours is set
+    // after them
+    if ((err = AsyncQueue_process(self, SIZE_MAX, NULL)) != OS_SUCCESS)
+    {
+        return err;
+    }
+    IoError_clear();
+    TRACE_OP(UNMOUNT);
+
+    if ((err = Lock_acquire(self, self->lock.instance, true)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    NameCache_clear(self);
+
+    if ((err = WriteCombine_flushAll(self)) == OS_SUCCESS &&
+        (err = self->fsOps->unmount(self)) == OS_SUCCESS)
+    {
+        self->mounted = false;
+        err = Storage_flush(self);
+    }
+
+    Lock_release(self, self->lock.instance, true);
+
+    STATS_OP(self, UNMOUNT, 0, err);
+
+    return err;
+}
+
+OS_Error_t
+OS_FileSystem_sync(
+    OS_FileSystem_Handle_t self)
+{
+    OS_Error_t err, ret;
+
+    if (NULL == self)
+    {
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+
+    STATS_START(self);
+    TRACE_OP(SYNC);
+    IoError_clear();
+
+    if ((err = Lock_acquire(self, self->lock.instance, true)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    // The backends only pass the changes of the files on to the block cache,
+    // which is flushed once for all of them
+    Storage_deferFlush(true);
+    err = WriteCombine_flushAll(self);
+    for (size_t i = 0; i < self->handles.count; i++)
+    {
+        if (HandleBitmap_inUse(&self->handles, i) &&
+            (ret = self->fileOps->sync(self, i)) != OS_SUCCESS &&
+            OS_SUCCESS == err)
+        {
+            err = ret;
+        }
+    }
+    Storage_deferFlush(false);
+
+    if ((ret = Storage_flush(self)) != OS_SUCCESS && OS_SUCCESS == err)
+    {
+        err = ret;
+    }
+
+    Lock_release(self, self->lock.instance, true);
+
+    STATS_OP(self, SYNC, 0, err);
+
+    return err;
+}
+
+OS_Error_t
+OS_FileSystem_wipe(
+    OS_FileSystem_Handle_t self)
+{
+    OS_Error_t err;
+
+    if (NULL == self)
+    {
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+
+    STATS_START(self);
+    TRACE_OP(WIPE);
+    IoError_clear();
+
+    if ((err = Lock_acquire(self, self->lock.instance, true)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    if (!isUnused(self))
+    {
+        err = OS_ERROR_INVALID_STATE;
+    }
+    else
+    {
+        for (size_t i = 0; i < self->handles.count; i++)
+        {
+            WriteCombine_close(self, i);
+        }
+        NameCache_clear(self);
+        ReadAhead_reset(self);
+
+        err = self->fsOps->wipe(self);
+    }
+
+    Lock_release(self, self->lock.instance, true);
+
+    STATS_OP(self, WIPE, 0, err);
+
+    return err;
+}
+
+OS_Error_t
+OS_FileSystem_getCacheStats(
+    OS_FileSystem_Handle_t      self,
+    OS_FileSystem_CacheStats_t* stats)
+{
+    OS_Error_t err;
+
+    if (NULL == self || NULL == stats)
+    {
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+    if (!Storage_isCached(self))
+    {
+        return OS_ERROR_NOT_SUPPORTED;
+    }
+
+    if ((err = Lock_acquire(self, self->lock.backend, true)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    *stats = self->cache.stats;
+
+    Lock_release(self, self->lock.backend, true);
+
+    return OS_SUCCESS;
+}
+
+OS_Error_t
+OS_FileSystem_processAsync(
+    OS_FileSystem_Handle_t self,
+    const size_t           maxRequests,
+    size_t*                processed)
+{
+    if (NULL == self)
+    {
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+    if (!AsyncQueue_isEnabled(self))
+    {
+        return OS_ERROR_NOT_SUPPORTED;
+    }
+
+    return AsyncQueue_process(self, maxRequests, processed);
+}
+
+OS_Error_t
+OS_FileSystem_pollAsync(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystem_AsyncToken_t token,
+    OS_Error_t*                result)
+{
+    if (NULL == self || NULL == result)
+    {
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+    if (!AsyncQueue_isEnabled(self))
+    {
+        return OS_ERROR_NOT_SUPPORTED;
+    }
+
+    return AsyncQueue_poll(self, token, result);
+}
+
+OS_Error_t
+OS_FileSystem_getStats(
+    OS_FileSystem_Handle_t self,
+    OS_FileSystem_Stats_t* stats)
+{
+#if defined(OS_FILESYSTEM_WITH_STATISTICS)
+    OS_Error_t err;
+
+    if (NULL == self || NULL == stats)
+    {
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+
+    // The counters are updated without lock, a snapshot may be slightly off
+    memcpy(stats->ops, self->stats.ops, sizeof(stats->ops));
+    memcpy(stats->storage, self->stats.storage, sizeof(stats->storage));
+
+    if ((err = Lock_acquire(self, self->lock.backend, true)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    stats->cache = self->cache.stats;
+
+    Lock_release(self, self->lock.backend, true);
+
+    return OS_SUCCESS;
+#else
+    return (NULL == self || NULL == stats) ?
+           OS_ERROR_INVALID_PARAMETER : OS_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+OS_Error_t
+OS_FileSystem_resetStats(
+    OS_FileSystem_Handle_t self)
+{
+#if defined(OS_FILESYSTEM_WITH_STATISTICS)
+    OS_Error_t err;
+
+    if (NULL == self)
+    {
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+
+    memset(&self->stats, 0, sizeof(self->stats));
+
+    if ((err = Lock_acquire(self, self->lock.backend, true)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    memset(&self->cache.stats, 0, sizeof(self->cache.stats));
+
+    Lock_release(self, self->lock.backend, true);
+
+    return OS_SUCCESS;
+#else
     return (NULL == self) ?
-           OS_ERROR_INVALID_PARAMETER :
-           self->fsOps->unmount(self);
+           OS_ERROR_INVALID_PARAMETER : OS_ERROR_NOT_SUPPORTED;
+#endif
 }
@@ -7,8 +7,19 @@
  */
 
 #include "OS_FileSystem.h"
+#include "OS_FileSystem_ext.h"
 #include "OS_FileSystem_int.h"
 
+#include "lib/AsyncQueue.h"
+#include "lib/IoError.h"
+#include "lib/Lock.h"
+#include "lib/NameCache.h"
+#include "lib/ReadAhead.h"
+#include "lib/Stats.h"
+#include "lib/Storage.h"
+#include "lib/Trace.h"
+#include "lib/WriteCombine.h"
+
 #if defined(OS_FILESYSTEM_REMOVE_DEBUG_LOGGING)
 #undef Debug_Config_PRINT_TO_LOG_SERVER
 #endif
@@ -17,59 +28,357 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 // Private Functions -----------------------------------------------------------
 
-static OS_FileSystemFile_Handle_t
-fileHandle_findFree(
+static bool
+fileHandle_inUse(
+    OS_FileSystem_Handle_t           self,
+    const OS_FileSystemFile_Handle_t hFile)
+{
+    return HandleBitmap_inUse(&self->handles, hFile);
+}
+
+static bool
+fileHandle_isValid(
+    OS_FileSystem_Handle_t           self,
+    const OS_FileSystemFile_Handle_t hFile)
+{
+    return hFile >= 0 && (size_t) hFile < self->handles.count;
+}
+
+static void*
+backendLock(
     OS_FileSystem_Handle_t self)
 {
-    UsageBitField_t u = self->usageBitField;
+    return self->fileOps->selfLocking ? NULL : self->lock.backend;
+}
+
+static void*
+fileLock(
+    OS_FileSystem_Handle_t           self,
+    const OS_FileSystemFile_Handle_t hFile)
+{
+    return (NULL == self->lock.files) ? NULL : self->lock.files[hFile];
+}
+
+/*
+ * Operations on an open file hold the instance lock shared, which keeps the
+ * file from being closed, and the lock of the file, which orders operations on
+ * the same file. The backend lock is taken last and only for the backends
+ * which do not take it themselves.
+ */
+static OS_Error_t
+file_enter(
+    OS_FileSystem_Handle_t           self,
+    const OS_FileSystemFile_Handle_t hFile)
+{
+    OS_Error_t err;
 
-    for (size_t i = 0; i < MAX_FILE_HANDLES; i++)
+    if ((err = Lock_acquire(self, self->lock.instance, false)) != OS_SUCCESS)
     {
-        if ((u & 1ULL) == 0)
-        {
-            // The file handles are array indizes and so we can simply return
-            // the loop-index of the first unused file handle.
-            return i;
-        }
-        u >>= 1;
+        return err;
+    }
+    if (!fileHandle_isValid(self, hFile) || !fileHandle_inUse(self, hFile))
+    {
+        err = OS_ERROR_INVALID_HANDLE;
+        goto err0;
+    }
+    if ((err = Lock_acquire(self, fileLock(self, hFile), true)) != OS_SUCCESS)
+    {
+        goto err0;
+    }
+    if ((err = Lock_acquire(self, backendLock(self), true)) != OS_SUCCESS)
+    {
+        goto err1;
     }
 
-    return MAX_FILE_HANDLES;
+    return OS_SUCCESS;
+
+err1:
+    Lock_release(self, fileLock(self, hFile), true);
+err0:
+    Lock_release(self, self->lock.instance, false);
+    return err;
 }
 
 static void
-fileHandle_take(
+file_leave(
     OS_FileSystem_Handle_t           self,
     const OS_FileSystemFile_Handle_t hFile)
 {
-    self->usageBitField |= (1ULL << hFile);
+    Lock_release(self, backendLock(self), true);
+    Lock_release(self, fileLock(self, hFile), true);
+    Lock_release(self, self->lock.instance, false);
 }
 
-static void
-fileHandle_release(
+static OS_FileSystemFile_Handle_t
+fileHandle_find(
+    OS_FileSystem_Handle_t self,
+    const char*            name)
+{
+    for (size_t i = 0; i < self->handles.count; i++)
+    {
+        if (NULL != self->names[i] && strcmp(self->names[i], name) == 0)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * The size of an open file is taken from its state in the backend, including
+ * data which is still held back by the file system. Expects the lock of the
+ * file and the backend lock to be held.
+ */
+static OS_Error_t
+file_getSize(
     OS_FileSystem_Handle_t           self,
-    const OS_FileSystemFile_Handle_t hFile)
+    const OS_FileSystemFile_Handle_t hFile,
+    off_t*                           sz)
 {
-    self->usageBitField &= ~(1ULL << hFile);
+    OS_Error_t err;
+
+    if ((err = WriteCombine_flush(self, hFile)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    return self->fileOps->getSizeByHandle(self, hFile, sz);
 }
 
-static bool
-fileHandle_inUse(
+/*
+ * Open a file through the name cache. A file which is just opened is found by
+ * its identity if the cache has it, a name known to have no file fails right
+ * away. Expects the instance lock to be held exclusively.
+ */
+static OS_Error_t
+file_open(
     OS_FileSystem_Handle_t           self,
-    const OS_FileSystemFile_Handle_t hFile)
+    const OS_FileSystemFile_Handle_t hFile,
+    const char*                      name,
+    const OS_FileSystem_OpenMode_t   mode,
+    const OS_FileSystem_OpenFlags_t  flags)
 {
-    return (self->usageBitField & (1ULL << hFile));
+    const OS_FileSystem_FileOps_t* ops = self->fileOps;
+    const bool create = flags & OS_FileSystem_OpenFlags_CREATE;
+    const bool plain = !(flags & (OS_FileSystem_OpenFlags_CREATE |
+                                  OS_FileSystem_OpenFlags_EXCLUSIVE |
+                                  OS_FileSystem_OpenFlags_TRUNCATE));
+    NameCache_Id_t id;
+    bool hasId;
+    OS_Error_t err;
+
+    if (plain)
+    {
+        switch (NameCache_lookup(self, name, &id))
+        {
+        case NameCache_State_MISSING:
+            return OS_ERROR_NOT_FOUND;
+        case NameCache_State_FOUND:
+            if ((err = ops->openById(self, hFile, &id,
+                                     mode)) != OS_ERROR_NOT_FOUND)
+            {
+                return err;
+            }
+            // The file is gone, but there may be another one of the name
+            NameCache_remove(self, name);
+            break;
+        default:
+            break;
+        }
+    }
+
+    if ((err = ops->open(self, hFile, name, mode, flags)) != OS_SUCCESS)
+    {
+        if (create)
+        {
+            NameCache_create(self, name, NULL);
+        }
+        else if (OS_ERROR_NOT_FOUND == err)
+        {
+            NameCache_insert(self, name, NULL);
+        }
+        return err;
+    }
+
+    // The cache compares identities as a whole, including their padding
+    memset(&id, 0, sizeof(id));
+    hasId = NameCache_isEnabled(self) && NULL != ops->getId &&
+            ops->getId(self, hFile, &id) == OS_SUCCESS;
+
+    if (create)
+    {
+        NameCache_create(self, name, hasId ? &id : NULL);
+    }
+    else if (hasId)
+    {
+        NameCache_insert(self, name, &id);
+    }
+
+    return OS_SUCCESS;
+}
+
+/*
+ * Look up the size of a file which is not open through the name cache. Other
+ * threads may look up names at the same time, so the cache is accessed under
+ * the backend lock; it is not held while calling a backend which takes the
+ * lock itself. Expects the instance lock to be held shared.
+ */
+static OS_Error_t
+name_getSize(
+    OS_FileSystem_Handle_t self,
+    const char*            name,
+    off_t*                 sz)
+{
+    NameCache_State_t state = NameCache_State_UNKNOWN;
+    NameCache_Id_t id;
+    bool stale = false;
+    OS_Error_t err;
+
+    if (NameCache_isEnabled(self))
+    {
+        if ((err = Lock_acquire(self, self->lock.backend, true)) != OS_SUCCESS)
+        {
+            return err;
+        }
+        state = NameCache_lookup(self, name, &id);
+        Lock_release(self, self->lock.backend, true);
+    }
+
+    if (NameCache_State_MISSING == state)
+    {
+        return OS_ERROR_NOT_FOUND;
+    }
+
+    if ((err = Lock_acquire(self, backendLock(self), true)) != OS_SUCCESS)
+    {
+        return err;
+    }
+    if (NameCache_State_FOUND == state)
+    {
+        err = self->fileOps->getSizeById(self, &id, sz);
+        stale = (OS_ERROR_NOT_FOUND == err);
+    }
+    if (NameCache_State_FOUND != state || stale)
+    {
+        err = self->fileOps->getSize(self, name, sz);
+    }
+    Lock_release(self, backendLock(self), true);
+
+    if ((stale || OS_ERROR_NOT_FOUND == err) && NameCache_isEnabled(self) &&
+        Lock_acquire(self, self->lock.backend, true) == OS_SUCCESS)
+    {
+        if (OS_ERROR_NOT_FOUND == err)
+        {
+            NameCache_insert(self, name, NULL);
+        }
+        else
+        {
+            NameCache_remove(self, name);
+        }
+        Lock_release(self, self->lock.backend, true);
+    }
+
+    return err;
+}
+
+static size_t
+ioVecLen(
+    const OS_FileSystemFile_IoVec_t* iov,
+    const size_t                     iovCount)
+{
+    size_t len = 0;
+
+    for (size_t i = 0; i < iovCount; i++)
+    {
+        len += iov[i].len;
+    }
+    return len;
 }
 
 static bool
-fileHandle_isValid(
-    OS_FileSystem_Handle_t           self,
-    const OS_FileSystemFile_Handle_t hFile)
+isIoVecOk(
+    const OS_FileSystemFile_IoVec_t* iov,
+    const size_t                     iovCount)
 {
-    return hFile >= 0 && hFile < MAX_FILE_HANDLES;
+    if (NULL == iov)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < iovCount; i++)
+    {
+        if (NULL == iov[i].buffer)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Flush the block cache after syncing a file with group commit. Threads which
+ * synced their files while another one was flushing find their changes written
+ * by that flush already, or share the next one.
+ */
+static OS_Error_t
+commit(
+    OS_FileSystem_Handle_t self)
+{
+    OS_Error_t err;
+
+    if ((err = Lock_acquire(self, self->lock.instance, false)) != OS_SUCCESS)
+    {
+        return err;
+    }
+    if ((err = Lock_acquire(self, self->lock.backend, true)) == OS_SUCCESS)
+    {
+        err = Storage_flush(self);
+        Lock_release(self, self->lock.backend, true);
+    }
+    Lock_release(self, self->lock.instance, false);
+
+    return err;
+}
+
+static OS_Error_t
+submitAsync(
+    OS_FileSystem_Handle_t      self,
+    const AsyncQueue_Request_t* req,
+    OS_FileSystem_AsyncToken_t* token)
+{
+    OS_Error_t err;
+
+    if (NULL == self || NULL == token ||
+        (req->offset < 0 && req->offset != OS_FileSystemFile_OFFSET_CURRENT))
+    {
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+    if (AsyncQueue_Op_SYNC != req->op && NULL == req->iov.buffer)
+    {
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+    if (!AsyncQueue_isEnabled(self))
+    {
+        return OS_ERROR_NOT_SUPPORTED;
+    }
+
+    if ((err = Lock_acquire(self, self->lock.instance, false)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    err = (!fileHandle_isValid(self, req->hFile) ||
+           !fileHandle_inUse(self, req->hFile)) ?
+          OS_ERROR_INVALID_HANDLE :
+          AsyncQueue_submit(self, req, token);
+
+    Lock_release(self, self->lock.instance, false);
+
+    return err;
 }
 
 // Public Functions ------------------------------------------------------------
@@ -82,6 +391,10 @@ OS_FileSystemFile_open(
     const OS_FileSystem_OpenMode_t  mode,
     const OS_FileSystem_OpenFlags_t flags)
 {
+    // The access pattern hints are for the read-ahead only
+    const OS_FileSystem_OpenFlags_t fsFlags =
+        flags & ~(OS_FileSystem_OpenFlags_SEQUENTIAL |
+                  OS_FileSystem_OpenFlags_RANDOM);
     OS_Error_t err;
 
     if (NULL == self || NULL == hFile || NULL == name)
@@ -95,17 +408,62 @@ OS_FileSystemFile_open(
         return OS_ERROR_INVALID_PARAMETER;
     }
 
-    if ((*hFile = fileHandle_findFree(self)) >= MAX_FILE_HANDLES)
+    STATS_START(self);
+    TRACE_OP(OPEN);
+    IoError_clear();
+
+    if ((err = Lock_acquire(self, self->lock.instance, true)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    // The file handles are array indizes, the state the backend keeps for an
+    // open file is allocated in the slot of its handle
+    if ((*hFile = HandleBitmap_take(&self->handles)) >= self->handles.count)
     {
         Debug_LOG_ERROR("All file handles are in use");
-        return OS_ERROR_OUT_OF_BOUNDS;
+        err = OS_ERROR_OUT_OF_BOUNDS;
+        goto err0;
     }
 
-    if ((err = self->fileOps->open(self, *hFile, name, mode, flags)) == OS_SUCCESS)
+    if ((self->files[*hFile] = calloc(1, self->fileOps->fileSize)) == NULL)
     {
-        fileHandle_take(self, *hFile);
+        err = OS_ERROR_INSUFFICIENT_SPACE;
+        goto err1;
     }
 
+    if ((err = Lock_createFile(self, *hFile)) != OS_SUCCESS)
+    {
+        goto err2;
+    }
+
+    if ((err = file_open(self, *hFile, name, mode, fsFlags)) != OS_SUCCESS)
+    {
+        goto err3;
+    }
+
+    ReadAhead_open(self, *hFile, flags);
+    WriteCombine_open(self, *hFile, mode);
+
+    // Without the name, the file is just not found by getSize()
+    self->names[*hFile] = strdup(name);
+
+    Lock_release(self, self->lock.instance, true);
+
+    STATS_OP(self, OPEN, 0, OS_SUCCESS);
+
+    return OS_SUCCESS;
+
+err3:
+    Lock_destroyFile(self, *hFile);
+err2:
+    free(self->files[*hFile]);
+    self->files[*hFile] = NULL;
+err1:
+    HandleBitmap_release(&self->handles, *hFile);
+err0:
+    Lock_release(self, self->lock.instance, true);
+    STATS_OP(self, OPEN, 0, err);
     return err;
 }
 
@@ -114,21 +472,55 @@ OS_FileSystemFile_close(
     OS_FileSystem_Handle_t     self,
     OS_FileSystemFile_Handle_t hFile)
 {
-    OS_Error_t err;
+    OS_Error_t err, flushErr;
 
     if (NULL == self)
     {
         return OS_ERROR_INVALID_PARAMETER;
     }
-    if (!fileHandle_isValid(self, hFile) || !fileHandle_inUse(self, hFile))
+
+    STATS_START(self);
+
+    // Queued requests may refer to the file, so they have to be done first;
+    // they note their own operation for the trace, so ours is set after them
+    if ((err = AsyncQueue_process(self, SIZE_MAX, NULL)) != OS_SUCCESS)
+    {
+        return err;
+    }
+    IoError_clear();
+    TRACE_OP(CLOSE);
+
+    if ((err = Lock_acquire(self, self->lock.instance, true)) != OS_SUCCESS)
     {
-        return OS_ERROR_INVALID_HANDLE;
+        return err;
     }
 
-    if ((err = self->fileOps->close(self, hFile)) == OS_SUCCESS)
+    if (!fileHandle_isValid(self, hFile) || !fileHandle_inUse(self, hFile))
     {
-        fileHandle_release(self, hFile);
+        err = OS_ERROR_INVALID_HANDLE;
     }
+    else
+    {
+        // The file is closed even if its buffered data could not be written,
+        // that error is returned then
+        flushErr = WriteCombine_flush(self, hFile);
+        if ((err = self->fileOps->close(self, hFile)) == OS_SUCCESS)
+        {
+            err = flushErr;
+            AsyncQueue_releaseFile(self, hFile);
+            WriteCombine_close(self, hFile);
+            Lock_destroyFile(self, hFile);
+            free(self->files[hFile]);
+            self->files[hFile] = NULL;
+            free(self->names[hFile]);
+            self->names[hFile] = NULL;
+            HandleBitmap_release(&self->handles, hFile);
+        }
+    }
+
+    Lock_release(self, self->lock.instance, true);
+
+    STATS_OP(self, CLOSE, 0, err);
 
     return err;
 }
@@ -141,36 +533,229 @@ OS_FileSystemFile_read(
     const size_t               len,
     void*                      buffer)
 {
-    if (NULL == self || NULL == buffer)
+    const OS_FileSystemFile_IoVec_t iov = { .buffer = buffer, .len = len };
+
+    return OS_FileSystemFile_readv(self, hFile, offset, &iov, 1);
+}
+
+OS_Error_t
+OS_FileSystemFile_write(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile,
+    const off_t                offset,
+    const size_t               len,
+    const void*                buffer)
+{
+    const OS_FileSystemFile_IoVec_t iov =
+    {
+        .buffer = (void*) buffer,
+        .len    = len
+    };
+
+    return OS_FileSystemFile_writev(self, hFile, offset, &iov, 1);
+}
+
+OS_Error_t
+OS_FileSystemFile_readv(
+    OS_FileSystem_Handle_t           self,
+    OS_FileSystemFile_Handle_t       hFile,
+    const off_t                      offset,
+    const OS_FileSystemFile_IoVec_t* iov,
+    const size_t                     iovCount)
+{
+    OS_Error_t err;
+
+    if (NULL == self || !isIoVecOk(iov, iovCount) ||
+        (offset < 0 && offset != OS_FileSystemFile_OFFSET_CURRENT))
     {
         return OS_ERROR_INVALID_PARAMETER;
     }
-    if (!fileHandle_isValid(self, hFile) || !fileHandle_inUse(self, hFile))
+
+    STATS_START(self);
+    TRACE_OP(READ);
+    IoError_clear();
+
+    if ((err = file_enter(self, hFile)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    if ((err = WriteCombine_flush(self, hFile)) == OS_SUCCESS)
     {
-        return OS_ERROR_INVALID_HANDLE;
+        ReadAhead_begin(self, hFile, offset);
+        err = self->fileOps->readv(self, hFile, offset, iov, iovCount);
+        ReadAhead_end(self, hFile, offset, ioVecLen(iov, iovCount), err);
     }
 
-    return self->fileOps->read(self, hFile, offset, len, buffer);
+    file_leave(self, hFile);
+
+    STATS_OP(self, READ, ioVecLen(iov, iovCount), err);
+
+    return err;
 }
 
 OS_Error_t
-OS_FileSystemFile_write(
+OS_FileSystemFile_writev(
+    OS_FileSystem_Handle_t           self,
+    OS_FileSystemFile_Handle_t       hFile,
+    const off_t                      offset,
+    const OS_FileSystemFile_IoVec_t* iov,
+    const size_t                     iovCount)
+{
+    OS_Error_t err;
+
+    if (NULL == self || !isIoVecOk(iov, iovCount) ||
+        (offset < 0 && offset != OS_FileSystemFile_OFFSET_CURRENT))
+    {
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+
+    STATS_START(self);
+    TRACE_OP(WRITE);
+    IoError_clear();
+
+    if ((err = file_enter(self, hFile)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    err = WriteCombine_write(self, hFile, offset, iov, iovCount);
+
+    file_leave(self, hFile);
+
+    STATS_OP(self, WRITE, ioVecLen(iov, iovCount), err);
+
+    return err;
+}
+
+OS_Error_t
+OS_FileSystemFile_readNext(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile,
+    const size_t               len,
+    void*                      buffer)
+{
+    return OS_FileSystemFile_read(self, hFile, OS_FileSystemFile_OFFSET_CURRENT,
+                                  len, buffer);
+}
+
+OS_Error_t
+OS_FileSystemFile_writeNext(
     OS_FileSystem_Handle_t     self,
     OS_FileSystemFile_Handle_t hFile,
-    const off_t                offset,
     const size_t               len,
     const void*                buffer)
 {
-    if (NULL == self || NULL == buffer)
+    return OS_FileSystemFile_write(self, hFile, OS_FileSystemFile_OFFSET_CURRENT,
+                                   len, buffer);
+}
+
+OS_Error_t
+OS_FileSystemFile_sync(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile)
+{
+    OS_Error_t err;
+
+    if (NULL == self)
     {
         return OS_ERROR_INVALID_PARAMETER;
     }
-    if (!fileHandle_isValid(self, hFile) || !fileHandle_inUse(self, hFile))
+
+    STATS_START(self);
+    TRACE_OP(SYNC);
+    IoError_clear();
+
+    if ((err = file_enter(self, hFile)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    // With group commit, the block cache is flushed once the file is released
+    Storage_deferFlush(self->extCfg.groupCommit);
+    if ((err = WriteCombine_flush(self, hFile)) == OS_SUCCESS)
+    {
+        err = self->fileOps->sync(self, hFile);
+    }
+    Storage_deferFlush(false);
+
+    file_leave(self, hFile);
+
+    if (OS_SUCCESS == err && self->extCfg.groupCommit)
     {
-        return OS_ERROR_INVALID_HANDLE;
+        err = commit(self);
     }
 
-    return self->fileOps->write(self, hFile, offset, len, buffer);
+    STATS_OP(self, SYNC, 0, err);
+
+    return err;
+}
+
+OS_Error_t
+OS_FileSystemFile_readAsync(
+    OS_FileSystem_Handle_t        self,
+    OS_FileSystemFile_Handle_t    hFile,
+    const off_t                   offset,
+    const size_t                  len,
+    void*                         buffer,
+    OS_FileSystem_AsyncCallback_t callback,
+    void*                         ctx,
+    OS_FileSystem_AsyncToken_t*   token)
+{
+    AsyncQueue_Request_t req =
+    {
+        .op       = AsyncQueue_Op_READ,
+        .hFile    = hFile,
+        .offset   = offset,
+        .iov      = { .buffer = buffer, .len = len },
+        .callback = callback,
+        .ctx      = ctx,
+    };
+
+    return submitAsync(self, &req, token);
+}
+
+OS_Error_t
+OS_FileSystemFile_writeAsync(
+    OS_FileSystem_Handle_t        self,
+    OS_FileSystemFile_Handle_t    hFile,
+    const off_t                   offset,
+    const size_t                  len,
+    const void*                   buffer,
+    OS_FileSystem_AsyncCallback_t callback,
+    void*                         ctx,
+    OS_FileSystem_AsyncToken_t*   token)
+{
+    AsyncQueue_Request_t req =
+    {
+        .op       = AsyncQueue_Op_WRITE,
+        .hFile    = hFile,
+        .offset   = offset,
+        .iov      = { .buffer = (void*) buffer, .len = len },
+        .callback = callback,
+        .ctx      = ctx,
+    };
+
+    return submitAsync(self, &req, token);
+}
+
+OS_Error_t
+OS_FileSystemFile_syncAsync(
+    OS_FileSystem_Handle_t        self,
+    OS_FileSystemFile_Handle_t    hFile,
+    OS_FileSystem_AsyncCallback_t callback,
+    void*                         ctx,
+    OS_FileSystem_AsyncToken_t*   token)
+{
+    AsyncQueue_Request_t req =
+    {
+        .op       = AsyncQueue_Op_SYNC,
+        .hFile    = hFile,
+        .callback = callback,
+        .ctx      = ctx,
+    };
+
+    return submitAsync(self, &req, token);
 }
 
 OS_Error_t
@@ -178,12 +763,44 @@ OS_FileSystemFile_delete(
     OS_FileSystem_Handle_t self,
     const char*            name)
 {
+    NameCache_Id_t id;
+    OS_Error_t err;
+
     if (NULL == self || NULL == name)
     {
         return OS_ERROR_INVALID_PARAMETER;
     }
 
-    return self->fileOps->delete (self, name);
+    STATS_START(self);
+    TRACE_OP(DELETE);
+    IoError_clear();
+
+    if ((err = Lock_acquire(self, self->lock.instance, true)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    // A name known to have no file is not looked up again; afterwards, the
+    // name has no file unless the delete failed for another reason
+    if (NameCache_lookup(self, name, &id) == NameCache_State_MISSING)
+    {
+        err = OS_ERROR_NOT_FOUND;
+    }
+    else if ((err = self->fileOps->delete (self, name)) == OS_SUCCESS ||
+             OS_ERROR_NOT_FOUND == err)
+    {
+        NameCache_insert(self, name, NULL);
+    }
+    else
+    {
+        NameCache_remove(self, name);
+    }
+
+    Lock_release(self, self->lock.instance, true);
+
+    STATS_OP(self, DELETE, 0, err);
+
+    return err;
 }
 
 OS_Error_t
@@ -192,10 +809,78 @@ OS_FileSystemFile_getSize(
     const char*            name,
     off_t*                 sz)
 {
+    OS_FileSystemFile_Handle_t hFile;
+    OS_Error_t err;
+
     if (NULL == self || NULL == name || NULL == sz)
     {
         return OS_ERROR_INVALID_PARAMETER;
     }
 
-    return self->fileOps->getSize(self, name, sz);
+    STATS_START(self);
+    TRACE_OP(GET_SIZE);
+    IoError_clear();
+
+    if ((err = Lock_acquire(self, self->lock.instance, false)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    // If the file is open, its size is known without looking it up
+    if ((hFile = fileHandle_find(self, name)) >= 0)
+    {
+        if ((err = Lock_acquire(self, fileLock(self, hFile),
+                                true)) != OS_SUCCESS)
+        {
+            goto err0;
+        }
+        if ((err = Lock_acquire(self, backendLock(self), true)) == OS_SUCCESS)
+        {
+            err = file_getSize(self, hFile, sz);
+            Lock_release(self, backendLock(self), true);
+        }
+        Lock_release(self, fileLock(self, hFile), true);
+    }
+    else
+    {
+        err = name_getSize(self, name, sz);
+    }
+
+err0:
+    Lock_release(self, self->lock.instance, false);
+
+    STATS_OP(self, GET_SIZE, 0, err);
+
+    return err;
+}
+
+OS_Error_t
+OS_FileSystemFile_getSizeByHandle(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile,
+    off_t*                     sz)
+{
+    OS_Error_t err;
+
+    if (NULL == self || NULL == sz)
+    {
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+
+    STATS_START(self);
+    TRACE_OP(GET_SIZE);
+    IoError_clear();
+
+    if ((err = file_enter(self, hFile)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    err = file_getSize(self, hFile, sz);
+
+    file_leave(self, hFile);
+
+    STATS_OP(self, GET_SIZE, 0, err);
+
+    return err;
 }
\ No newline at end of file
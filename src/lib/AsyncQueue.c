@@ -0,0 +1,321 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#include "OS_FileSystem.h"
+#include "OS_FileSystem_int.h"
+
+#include "lib/AsyncQueue.h"
+#include "lib/Lock.h"
+
+#if defined(OS_FILESYSTEM_REMOVE_DEBUG_LOGGING)
+#undef Debug_Config_PRINT_TO_LOG_SERVER
+#endif
+#include "lib_debug/Debug.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// The slot of a request is encoded in the lower half of the token, the upper
+// half distinguishes subsequent uses of the same slot
+#define ASYNC_QUEUE_MAX_SIZE    UINT16_MAX
+#define TOKEN(slot, gen)        (((uint32_t)(gen) << 16) | (slot))
+#define TOKEN_SLOT(token)       ((token) & 0xffff)
+#define TOKEN_GEN(token)        ((token) >> 16)
+
+// Attempts to take the queue lock for the completion of an executed request
+#define ASYNC_QUEUE_LOCK_RETRIES    3
+
+typedef enum
+{
+    REQUEST_FREE = 0,
+    REQUEST_QUEUED,
+    REQUEST_DONE,       // Waiting to be picked up with AsyncQueue_poll()
+} RequestState_t;
+
+// Private Functions -----------------------------------------------------------
+
+static void
+releaseSlot(
+    AsyncQueue_t* q,
+    uint16_t      slot)
+{
+    q->requests[slot].state = REQUEST_FREE;
+    q->freeSlots[q->free++] = slot;
+}
+
+// Requests go through the public functions, which take the locks of the file
+static OS_Error_t
+execute(
+    OS_FileSystem_Handle_t      self,
+    const AsyncQueue_Request_t* req)
+{
+    switch (req->op)
+    {
+    case AsyncQueue_Op_READ:
+        return OS_FileSystemFile_readv(self, req->hFile, req->offset,
+                                       &req->iov, 1);
+    case AsyncQueue_Op_WRITE:
+        return OS_FileSystemFile_writev(self, req->hFile, req->offset,
+                                        &req->iov, 1);
+    case AsyncQueue_Op_SYNC:
+        return OS_FileSystemFile_sync(self, req->hFile);
+    default:
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+}
+
+// Public Functions ------------------------------------------------------------
+
+OS_Error_t
+AsyncQueue_init(
+    OS_FileSystem_Handle_t self)
+{
+    AsyncQueue_t* q = &self->async;
+    size_t size = self->extCfg.async.queueSize;
+
+    if (0 == size)
+    {
+        return OS_SUCCESS;
+    }
+    if (size > ASYNC_QUEUE_MAX_SIZE)
+    {
+        Debug_LOG_ERROR("Request queue of %zu entries exceeds maximum of %u",
+                        size, ASYNC_QUEUE_MAX_SIZE);
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+
+    q->requests  = calloc(size, sizeof(AsyncQueue_Request_t));
+    q->fifo      = calloc(size, sizeof(uint16_t));
+    q->freeSlots = calloc(size, sizeof(uint16_t));
+    if (NULL == q->requests || NULL == q->fifo || NULL == q->freeSlots)
+    {
+        AsyncQueue_free(self);
+        return OS_ERROR_INSUFFICIENT_SPACE;
+    }
+
+    q->size = size;
+    for (size_t i = size; i > 0; i--)
+    {
+        releaseSlot(q, i - 1);
+    }
+
+    return OS_SUCCESS;
+}
+
+void
+AsyncQueue_free(
+    OS_FileSystem_Handle_t self)
+{
+    AsyncQueue_t* q = &self->async;
+
+    free(q->requests);
+    free(q->fifo);
+    free(q->freeSlots);
+    q->size = 0;
+}
+
+bool
+AsyncQueue_isEnabled(
+    OS_FileSystem_Handle_t self)
+{
+    return self->async.size > 0;
+}
+
+OS_Error_t
+AsyncQueue_submit(
+    OS_FileSystem_Handle_t      self,
+    const AsyncQueue_Request_t* request,
+    OS_FileSystem_AsyncToken_t* token)
+{
+    AsyncQueue_t* q = &self->async;
+    AsyncQueue_Request_t* req;
+    OS_Error_t err;
+    uint16_t slot, gen;
+
+    if ((err = Lock_acquire(self, self->lock.queue, true)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    if (0 == q->free)
+    {
+        Lock_release(self, self->lock.queue, true);
+        return OS_ERROR_TRY_AGAIN;
+    }
+
+    slot = q->freeSlots[--q->free];
+    req = &q->requests[slot];
+    gen = req->generation + 1;
+
+    *req = *request;
+    req->generation = gen;
+    req->state = REQUEST_QUEUED;
+    q->fifo[(q->head + q->queued++) % q->size] = slot;
+
+    Lock_release(self, self->lock.queue, true);
+
+    *token = TOKEN(slot, gen);
+
+    return OS_SUCCESS;
+}
+
+OS_Error_t
+AsyncQueue_process(
+    OS_FileSystem_Handle_t self,
+    size_t                 maxRequests,
+    size_t*                processed)
+{
+    AsyncQueue_t* q = &self->async;
+    AsyncQueue_Request_t* req;
+    OS_FileSystem_AsyncCallback_t callback;
+    OS_FileSystem_AsyncToken_t token;
+    OS_Error_t err, ret = OS_SUCCESS;
+    void* ctx;
+    size_t n = 0;
+    uint16_t slot;
+
+    while (n < maxRequests)
+    {
+        if ((ret = Lock_acquire(self, self->lock.queue, true)) != OS_SUCCESS)
+        {
+            break;
+        }
+        if (0 == q->queued)
+        {
+            Lock_release(self, self->lock.queue, true);
+            break;
+        }
+
+        slot = q->fifo[q->head];
+        q->head = (q->head + 1) % q->size;
+        q->queued--;
+
+        Lock_release(self, self->lock.queue, true);
+
+        // The request stays queued for pollers until it is completed below,
+        // so nobody else touches it meanwhile
+        req = &q->requests[slot];
+        err = execute(self, req);
+        token = TOKEN(slot, req->generation);
+        n++;
+
+        for (int i = 0; i < ASYNC_QUEUE_LOCK_RETRIES; i++)
+        {
+            if ((ret = Lock_acquire(self, self->lock.queue, true)) == OS_SUCCESS)
+            {
+                break;
+            }
+        }
+        if (ret != OS_SUCCESS)
+        {
+            // The completion of an executed request must not get lost. As
+            // nobody else touches the request, its result is kept for pollers
+            // without the lock; the slot is reclaimed when the file is closed.
+            callback = req->callback;
+            ctx = req->ctx;
+            req->callback = NULL;
+            req->result   = err;
+            req->state    = REQUEST_DONE;
+            if (NULL != callback)
+            {
+                callback(ctx, token, err);
+            }
+            break;
+        }
+
+        // Requests with a callback are done with once it is called; the slot
+        // is released before, so the callback can submit the next request
+        if (NULL != req->callback)
+        {
+            callback = req->callback;
+            ctx = req->ctx;
+            releaseSlot(q, slot);
+            Lock_release(self, self->lock.queue, true);
+            callback(ctx, token, err);
+        }
+        else
+        {
+            req->result = err;
+            req->state  = REQUEST_DONE;
+            Lock_release(self, self->lock.queue, true);
+        }
+    }
+
+    if (NULL != processed)
+    {
+        *processed = n;
+    }
+
+    return ret;
+}
+
+OS_Error_t
+AsyncQueue_poll(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystem_AsyncToken_t token,
+    OS_Error_t*                result)
+{
+    AsyncQueue_t* q = &self->async;
+    AsyncQueue_Request_t* req;
+    OS_Error_t err;
+
+    if (TOKEN_SLOT(token) >= q->size)
+    {
+        return OS_ERROR_NOT_FOUND;
+    }
+
+    if ((err = Lock_acquire(self, self->lock.queue, true)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    req = &q->requests[TOKEN_SLOT(token)];
+    if (req->generation != TOKEN_GEN(token) || REQUEST_FREE == req->state)
+    {
+        err = OS_ERROR_NOT_FOUND;
+    }
+    else if (REQUEST_QUEUED == req->state)
+    {
+        err = OS_ERROR_IN_PROGRESS;
+    }
+    else
+    {
+        *result = req->result;
+        releaseSlot(q, TOKEN_SLOT(token));
+    }
+
+    Lock_release(self, self->lock.queue, true);
+
+    return err;
+}
+
+void
+AsyncQueue_releaseFile(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile)
+{
+    AsyncQueue_t* q = &self->async;
+
+    if (0 == q->size ||
+        Lock_acquire(self, self->lock.queue, true) != OS_SUCCESS)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < q->size; i++)
+    {
+        if (REQUEST_DONE == q->requests[i].state &&
+            q->requests[i].hFile == hFile)
+        {
+            releaseSlot(q, i);
+        }
+    }
+
+    Lock_release(self, self->lock.queue, true);
+}
@@ -0,0 +1,597 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#include "OS_FileSystem.h"
+#include "lib/BlockCache.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ENTRY_NONE  UINT32_MAX
+#define ADDR_NONE   ((off_t) -1)
+
+// Private Functions -----------------------------------------------------------
+
+static inline uint8_t*
+entry_data(
+    BlockCache_t*  self,
+    const uint32_t idx)
+{
+    return self->data + ((size_t) idx * self->blockSize);
+}
+
+static inline bool
+entry_isDirty(
+    const BlockCache_Entry_t* e)
+{
+    return e->dirtyTo > e->dirtyFrom;
+}
+
+static inline uint32_t
+bucket_of(
+    BlockCache_t* self,
+    const off_t   addr)
+{
+    return (uint32_t) (addr / self->blockSize) & self->bucketMask;
+}
+
+static uint32_t
+lookup(
+    BlockCache_t* self,
+    const off_t   addr)
+{
+    uint32_t idx = self->buckets[bucket_of(self, addr)];
+
+    while (idx != ENTRY_NONE && self->entries[idx].addr != addr)
+    {
+        idx = self->entries[idx].chain;
+    }
+
+    return idx;
+}
+
+static void
+hash_insert(
+    BlockCache_t*  self,
+    const uint32_t idx)
+{
+    uint32_t* head = &self->buckets[bucket_of(self, self->entries[idx].addr)];
+
+    self->entries[idx].chain = *head;
+    *head = idx;
+}
+
+static void
+hash_remove(
+    BlockCache_t*  self,
+    const uint32_t idx)
+{
+    uint32_t* link = &self->buckets[bucket_of(self, self->entries[idx].addr)];
+
+    while (*link != idx)
+    {
+        link = &self->entries[*link].chain;
+    }
+    *link = self->entries[idx].chain;
+}
+
+static void
+lru_unlink(
+    BlockCache_t*  self,
+    const uint32_t idx)
+{
+    BlockCache_Entry_t* e = &self->entries[idx];
+
+    if (e->prev != ENTRY_NONE)
+    {
+        self->entries[e->prev].next = e->next;
+    }
+    else
+    {
+        self->lruHead = e->next;
+    }
+    if (e->next != ENTRY_NONE)
+    {
+        self->entries[e->next].prev = e->prev;
+    }
+    else
+    {
+        self->lruTail = e->prev;
+    }
+}
+
+static void
+lru_pushHead(
+    BlockCache_t*  self,
+    const uint32_t idx)
+{
+    BlockCache_Entry_t* e = &self->entries[idx];
+
+    e->prev = ENTRY_NONE;
+    e->next = self->lruHead;
+    if (self->lruHead != ENTRY_NONE)
+    {
+        self->entries[self->lruHead].prev = idx;
+    }
+    self->lruHead = idx;
+    if (self->lruTail == ENTRY_NONE)
+    {
+        self->lruTail = idx;
+    }
+}
+
+static void
+lru_pushTail(
+    BlockCache_t*  self,
+    const uint32_t idx)
+{
+    BlockCache_Entry_t* e = &self->entries[idx];
+
+    e->next = ENTRY_NONE;
+    e->prev = self->lruTail;
+    if (self->lruTail != ENTRY_NONE)
+    {
+        self->entries[self->lruTail].next = idx;
+    }
+    self->lruTail = idx;
+    if (self->lruHead == ENTRY_NONE)
+    {
+        self->lruHead = idx;
+    }
+}
+
+static void
+touch(
+    BlockCache_t*  self,
+    const uint32_t idx)
+{
+    if (self->lruHead != idx)
+    {
+        lru_unlink(self, idx);
+        lru_pushHead(self, idx);
+    }
+}
+
+static OS_Error_t
+writeBack(
+    BlockCache_t*  self,
+    const uint32_t idx)
+{
+    BlockCache_Entry_t* e = &self->entries[idx];
+    OS_Error_t err;
+
+    if (!entry_isDirty(e))
+    {
+        return OS_SUCCESS;
+    }
+
+    if ((err = self->storage.write(self->storage.ctx,
+                                   e->addr + e->dirtyFrom,
+                                   e->dirtyTo - e->dirtyFrom,
+                                   entry_data(self, idx) + e->dirtyFrom)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    e->dirtyFrom = e->dirtyTo = 0;
+    e->seq = 0;
+    self->stats.writeBacks++;
+
+    return OS_SUCCESS;
+}
+
+static int
+cmpDirty(
+    const void* a,
+    const void* b)
+{
+    const uint64_t* x = a;
+    const uint64_t* y = b;
+
+    return (*x > *y) - (*x < *y);
+}
+
+// Write back the blocks dirtied up to the given one, in the order they were
+// dirtied
+static OS_Error_t
+writeBackUpTo(
+    BlockCache_t*  self,
+    const uint64_t seq)
+{
+    uint64_t* order = self->order;
+    BlockCache_Entry_t* e;
+    OS_Error_t err;
+    size_t n = 0;
+
+    for (uint32_t i = 0; i < self->blockCount; i++)
+    {
+        e = &self->entries[i];
+        if (entry_isDirty(e) && e->seq <= seq)
+        {
+            order[2 * n]     = e->seq;
+            order[2 * n + 1] = i;
+            n++;
+        }
+    }
+
+    qsort(order, n, 2 * sizeof(uint64_t), cmpDirty);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        if ((err = writeBack(self, (uint32_t) order[2 * i + 1])) != OS_SUCCESS)
+        {
+            return err;
+        }
+    }
+
+    return OS_SUCCESS;
+}
+
+/*
+ * Add a range to the dirty data of a block. Data written to a block after
+ * other blocks were dirtied must not reach the storage before them, so the
+ * block is written back along with the ones dirtied before it first.
+ */
+static OS_Error_t
+markDirty(
+    BlockCache_t*  self,
+    const uint32_t idx,
+    const size_t   off,
+    const size_t   len)
+{
+    BlockCache_Entry_t* e = &self->entries[idx];
+    OS_Error_t err;
+
+    if (entry_isDirty(e) && e->seq != self->seq &&
+        (err = writeBackUpTo(self, e->seq)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    if (!entry_isDirty(e))
+    {
+        e->dirtyFrom = off;
+        e->dirtyTo   = off + len;
+        e->seq       = ++self->seq;
+    }
+    else
+    {
+        e->dirtyFrom = (off < e->dirtyFrom) ? off : e->dirtyFrom;
+        e->dirtyTo   = (off + len > e->dirtyTo) ? off + len : e->dirtyTo;
+    }
+
+    return OS_SUCCESS;
+}
+
+static void
+drop(
+    BlockCache_t*  self,
+    const uint32_t idx)
+{
+    BlockCache_Entry_t* e = &self->entries[idx];
+
+    hash_remove(self, idx);
+    e->addr = ADDR_NONE;
+    e->dirtyFrom = e->dirtyTo = 0;
+    e->seq = 0;
+
+    // Unused entries are the first ones to be recycled
+    lru_unlink(self, idx);
+    lru_pushTail(self, idx);
+}
+
+static OS_Error_t
+evict(
+    BlockCache_t* self,
+    uint32_t*     idx)
+{
+    uint32_t victim = self->lruTail;
+    OS_Error_t err;
+
+    if (self->entries[victim].addr != ADDR_NONE)
+    {
+        if (entry_isDirty(&self->entries[victim]) &&
+            (err = writeBackUpTo(self,
+                                 self->entries[victim].seq)) != OS_SUCCESS)
+        {
+            return err;
+        }
+        drop(self, victim);
+        self->stats.evictions++;
+    }
+
+    *idx = victim;
+
+    return OS_SUCCESS;
+}
+
+static void
+install(
+    BlockCache_t*  self,
+    const uint32_t idx,
+    const off_t    addr)
+{
+    self->entries[idx].addr = addr;
+    hash_insert(self, idx);
+    touch(self, idx);
+}
+
+/*
+ * Count how many of the blocks starting at addr are not in the cache; this is
+ * used to let runs of uncached blocks bypass the cache.
+ */
+static size_t
+countUncached(
+    BlockCache_t* self,
+    off_t         addr,
+    const size_t  maxBlocks)
+{
+    size_t n = 0;
+
+    while (n < maxBlocks && lookup(self, addr) == ENTRY_NONE)
+    {
+        addr += self->blockSize;
+        n++;
+    }
+
+    return n;
+}
+
+// Public Functions ------------------------------------------------------------
+
+OS_Error_t
+BlockCache_init(
+    BlockCache_t*               self,
+    size_t                      blockSize,
+    size_t                      blockCount,
+    const BlockCache_Storage_t* storage)
+{
+    size_t buckets;
+
+    memset(self, 0, sizeof(BlockCache_t));
+
+    if (0 == blockSize || 0 == blockCount || blockCount >= ENTRY_NONE)
+    {
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+
+    // Use a power of two for the number of hash buckets
+    for (buckets = 1; buckets < blockCount; buckets <<= 1)
+    {
+        ;
+    }
+
+    self->storage    = *storage;
+    self->blockSize  = blockSize;
+    self->blockCount = blockCount;
+    self->bucketMask = buckets - 1;
+
+    self->data    = malloc(blockCount * blockSize);
+    self->entries = calloc(blockCount, sizeof(BlockCache_Entry_t));
+    self->buckets = malloc(buckets * sizeof(uint32_t));
+    // For sorting we store sequence number and index of the dirty blocks side
+    // by side
+    self->order   = malloc(blockCount * 2 * sizeof(uint64_t));
+    if (NULL == self->data || NULL == self->entries ||
+        NULL == self->buckets || NULL == self->order)
+    {
+        BlockCache_free(self);
+        return OS_ERROR_INSUFFICIENT_SPACE;
+    }
+
+    memset(self->buckets, 0xff, buckets * sizeof(uint32_t));
+
+    self->lruHead = self->lruTail = ENTRY_NONE;
+    for (uint32_t i = 0; i < self->blockCount; i++)
+    {
+        self->entries[i].addr = ADDR_NONE;
+        lru_pushTail(self, i);
+    }
+
+    return OS_SUCCESS;
+}
+
+void
+BlockCache_free(
+    BlockCache_t* self)
+{
+    free(self->data);
+    free(self->entries);
+    free(self->buckets);
+    free(self->order);
+
+    memset(self, 0, sizeof(BlockCache_t));
+}
+
+OS_Error_t
+BlockCache_read(
+    BlockCache_t* self,
+    off_t         addr,
+    size_t        size,
+    void*         buffer)
+{
+    uint8_t* buf = buffer;
+    OS_Error_t err;
+    uint32_t idx;
+    size_t off, len, run;
+    off_t blk;
+
+    while (size > 0)
+    {
+        off = addr % self->blockSize;
+        blk = addr - off;
+        len = self->blockSize - off;
+        len = (len > size) ? size : len;
+
+        if ((idx = lookup(self, blk)) != ENTRY_NONE)
+        {
+            self->stats.hits++;
+            memcpy(buf, entry_data(self, idx) + off, len);
+            touch(self, idx);
+        }
+        else if (0 == off && size >= 2 * self->blockSize &&
+                 (run = countUncached(self, blk, size / self->blockSize)) > 1)
+        {
+            // Bulk transfer, do not pollute the cache with it
+            self->stats.misses++;
+            len = run * self->blockSize;
+            if ((err = self->storage.read(self->storage.ctx, blk, len,
+                                          buf)) != OS_SUCCESS)
+            {
+                return err;
+            }
+        }
+        else
+        {
+            self->stats.misses++;
+            if ((err = evict(self, &idx)) != OS_SUCCESS)
+            {
+                return err;
+            }
+            if ((err = self->storage.read(self->storage.ctx, blk,
+                                          self->blockSize,
+                                          entry_data(self, idx))) != OS_SUCCESS)
+            {
+                return err;
+            }
+            install(self, idx, blk);
+            memcpy(buf, entry_data(self, idx) + off, len);
+        }
+
+        buf  += len;
+        addr += len;
+        size -= len;
+    }
+
+    return OS_SUCCESS;
+}
+
+OS_Error_t
+BlockCache_write(
+    BlockCache_t* self,
+    off_t         addr,
+    size_t        size,
+    const void*   buffer)
+{
+    const uint8_t* buf = buffer;
+    OS_Error_t err;
+    uint32_t idx;
+    size_t off, len, run = 0;
+    off_t blk;
+
+    while (size > 0)
+    {
+        off = addr % self->blockSize;
+        blk = addr - off;
+        len = self->blockSize - off;
+        len = (len > size) ? size : len;
+
+        if ((idx = lookup(self, blk)) != ENTRY_NONE)
+        {
+            self->stats.hits++;
+            if ((err = markDirty(self, idx, off, len)) != OS_SUCCESS)
+            {
+                return err;
+            }
+            memcpy(entry_data(self, idx) + off, buf, len);
+            touch(self, idx);
+        }
+        else if (0 == off && len == self->blockSize &&
+                 (run = countUncached(self, blk, size / self->blockSize)) == 1)
+        {
+            // A single full block can be taken over without reading it first
+            self->stats.misses++;
+            if ((err = evict(self, &idx)) != OS_SUCCESS)
+            {
+                return err;
+            }
+            // The block is clean after the eviction, nothing to write back
+            memcpy(entry_data(self, idx), buf, len);
+            (void) markDirty(self, idx, 0, len);
+            install(self, idx, blk);
+        }
+        else
+        {
+            // Partial writes to uncached blocks and bulk transfers are passed
+            // on; the former would require to read the block first. What was
+            // written before has to reach the storage first.
+            self->stats.misses++;
+            if (0 == off && len == self->blockSize)
+            {
+                len = run * self->blockSize;
+            }
+            if ((err = BlockCache_flush(self)) != OS_SUCCESS)
+            {
+                return err;
+            }
+            if ((err = self->storage.write(self->storage.ctx, addr, len,
+                                           buf)) != OS_SUCCESS)
+            {
+                return err;
+            }
+        }
+
+        buf  += len;
+        addr += len;
+        size -= len;
+    }
+
+    return OS_SUCCESS;
+}
+
+OS_Error_t
+BlockCache_discard(
+    BlockCache_t* self,
+    off_t         addr,
+    off_t         size)
+{
+    BlockCache_Entry_t* e;
+    OS_Error_t err;
+
+    // Blocks which are erased completely are dropped along with their data
+    for (uint32_t i = 0; i < self->blockCount; i++)
+    {
+        e = &self->entries[i];
+        if (e->addr != ADDR_NONE && e->addr >= addr &&
+            e->addr + (off_t) self->blockSize <= addr + size)
+        {
+            drop(self, i);
+        }
+    }
+
+    // All other dirty blocks were written before the erase, so they have to
+    // reach the storage before it; blocks which are only partially affected
+    // keep some of their data that way.
+    if ((err = BlockCache_flush(self)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    for (uint32_t i = 0; i < self->blockCount; i++)
+    {
+        e = &self->entries[i];
+        if (e->addr != ADDR_NONE &&
+            e->addr + (off_t) self->blockSize > addr &&
+            e->addr < addr + size)
+        {
+            drop(self, i);
+        }
+    }
+
+    return OS_SUCCESS;
+}
+
+OS_Error_t
+BlockCache_flush(
+    BlockCache_t* self)
+{
+    return writeBackUpTo(self, UINT64_MAX);
+}
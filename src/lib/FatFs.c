@@ -17,6 +17,10 @@
 #endif
 #include "lib_debug/Debug.h"
 
+#include "lib/IoError.h"
+#include "lib/Lock.h"
+#include "lib/Storage.h"
+
 #include <string.h>
 #include <inttypes.h>
 
@@ -62,35 +66,17 @@ storage_read(
     OS_Error_t err;
     OS_FileSystem_Handle_t self = (OS_FileSystem_Handle_t) ctx;
     size_t sectorSize = self->cfg.format->fatFs.sectorSize;
-    off_t  addr;
-    size_t read, size;
 
-    size = sectorSize * count;
-    if (size > OS_Dataport_getSize(self->cfg.storage.dataport))
+    // FatFs passes multi-sector requests (e.g., direct reads of whole clusters
+    // into the caller's buffer) which may exceed the dataport; the storage
+    // layer takes care of splitting them up.
+    if ((err = Storage_read(self, (off_t) sectorSize * sector, sectorSize * count,
+                            buff)) != OS_SUCCESS)
     {
-        self->ioError = OS_ERROR_BUFFER_TOO_SMALL;
-        return RES_PARERR;
-    }
-
-    addr = sectorSize * sector;
-    if ((err = self->cfg.storage.read(addr, size, &read)) != OS_SUCCESS)
-    {
-        Debug_LOG_ERROR("read() failed with %d", err);
-        self->ioError = err;
+        IoError_set(err);
         return RES_ERROR;
     }
 
-    if (read != size)
-    {
-        Debug_LOG_ERROR("read() requested to read %zu bytes but got %zu bytes",
-                        size, read);
-        self->ioError = OS_ERROR_ABORTED;
-        return RES_ERROR;
-    }
-
-    memcpy(buff, OS_Dataport_getBuf(self->cfg.storage.dataport), read);
-
-    self->ioError = OS_SUCCESS;
     return RES_OK;
 }
 
@@ -105,35 +91,14 @@ storage_write(
     OS_Error_t err;
     OS_FileSystem_Handle_t self = (OS_FileSystem_Handle_t) ctx;
     size_t sectorSize = self->cfg.format->fatFs.sectorSize;
-    off_t addr;
-    size_t written, size;
 
-    size = sectorSize * count;
-    if (size > OS_Dataport_getSize(self->cfg.storage.dataport))
+    if ((err = Storage_write(self, (off_t) sectorSize * sector, sectorSize * count,
+                             buff)) != OS_SUCCESS)
     {
-        self->ioError = OS_ERROR_BUFFER_TOO_SMALL;
-        return RES_PARERR;
-    }
-
-    memcpy(OS_Dataport_getBuf(self->cfg.storage.dataport), buff, size);
-
-    addr = sectorSize * sector;
-    if ((err = self->cfg.storage.write(addr, size, &written)) != OS_SUCCESS)
-    {
-        Debug_LOG_ERROR("write() failed with %d", err);
-        self->ioError = err;
+        IoError_set(err);
         return RES_ERROR;
     }
 
-    if (written != size)
-    {
-        Debug_LOG_ERROR("write() requested to write %zu bytes but got %zu bytes",
-                        size, written);
-        self->ioError = OS_ERROR_ABORTED;
-        return RES_ERROR;
-    }
-
-    self->ioError = OS_SUCCESS;
     return RES_OK;
 }
 
@@ -145,11 +110,10 @@ storage_ioctl(
     void* buff)
 {
     OS_FileSystem_Handle_t self = (OS_FileSystem_Handle_t) ctx;
+    OS_Error_t err;
     size_t sectorSize = self->cfg.format->fatFs.sectorSize;
     size_t blockSize = self->cfg.format->fatFs.blockSize;
 
-    self->ioError = OS_SUCCESS;
-
     switch (cmd)
     {
     case GET_SECTOR_COUNT:
@@ -162,14 +126,38 @@ storage_ioctl(
         (*(DWORD*) buff) = (DWORD) blockSize;
         return RES_OK;
     case CTRL_SYNC:
+        if ((err = Storage_flush(self)) != OS_SUCCESS)
+        {
+            IoError_set(err);
+            return RES_ERROR;
+        }
+        return RES_OK;
     case CTRL_TRIM:
         return RES_OK;
     }
 
-    self->ioError = OS_ERROR_GENERIC;
     return RES_ERROR;
 }
 
+// FatFs locks the volume for each of its calls through these
+static int
+storage_lock(
+    void* ctx)
+{
+    OS_FileSystem_Handle_t self = (OS_FileSystem_Handle_t) ctx;
+
+    return (Lock_acquire(self, self->lock.backend, true) == OS_SUCCESS);
+}
+
+static void
+storage_unlock(
+    void* ctx)
+{
+    OS_FileSystem_Handle_t self = (OS_FileSystem_Handle_t) ctx;
+
+    Lock_release(self, self->lock.backend, true);
+}
+
 // Public Functions ------------------------------------------------------------
 
 OS_Error_t
@@ -206,6 +194,8 @@ FatFs_init(
     self->fs.fatFs.dio.disk_read = storage_read;
     self->fs.fatFs.dio.disk_write = storage_write;
     self->fs.fatFs.dio.disk_ioctl = storage_ioctl;
+    self->fs.fatFs.dio.lock = storage_lock;
+    self->fs.fatFs.dio.unlock = storage_unlock;
 
     // Assign context so we can get it in the callbacks
     self->fs.fatFs.dio.ctx = (void*) self;
@@ -264,7 +254,7 @@ FatFs_format(
                      sizeof(self->fs.fatFs.buffer))) != FR_OK)
     {
         Debug_LOG_ERROR("f_mkfs() failed with %d", rc);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
+        return IoError_get(OS_ERROR_GENERIC);
     }
 
     return OS_SUCCESS;
@@ -283,12 +273,11 @@ FatFs_mount(
                       &self->fs.fatFs.fs, "", mountNow)) != FR_OK)
     {
         Debug_LOG_ERROR("f_mount() failed with %d", rc);
-        // If we have an ioError, return that; otherwise check if FatFS detected
-        // that there is no FatFS on the storage and return NOT_FOUND; otherwise
-        // return GENERIC.
-        return (self->ioError != OS_SUCCESS)
-               ? self->ioError : (rc == FR_NO_FILESYSTEM)
-               ? OS_ERROR_NOT_FOUND : OS_ERROR_GENERIC;
+        // If we have an I/O error, return that; otherwise check if FatFS
+        // detected that there is no FatFS on the storage and return NOT_FOUND;
+        // otherwise return GENERIC.
+        return IoError_get((rc == FR_NO_FILESYSTEM) ?
+                           OS_ERROR_NOT_FOUND : OS_ERROR_GENERIC);
     }
 
     return OS_SUCCESS;
@@ -303,8 +292,18 @@ FatFs_unmount(
     if ((rc = f_mount(&self->fs.fatFs.fctx, NULL, "", 0)) != FR_OK)
     {
         Debug_LOG_ERROR("f_mount() failed with %d", rc);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
+        return IoError_get(OS_ERROR_GENERIC);
     }
 
     return OS_SUCCESS;
 }
+
+OS_Error_t
+FatFs_wipe(
+    OS_FileSystem_Handle_t self)
+{
+    // The block size is given in sectors, as FatFs expects it
+    return Storage_wipe(self,
+                        (off_t) self->cfg.format->fatFs.sectorSize *
+                        self->cfg.format->fatFs.blockSize);
+}
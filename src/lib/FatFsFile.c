@@ -17,8 +17,167 @@
 #endif
 #include "lib_debug/Debug.h"
 
+#include "lib/IoError.h"
+
+
+#include <stdlib.h>
+
 // Private Functions -----------------------------------------------------------
 
+// Files which do not exist are told apart, so the name cache can note them
+static OS_Error_t
+lookupError(
+    const FRESULT rc)
+{
+    return (FR_NO_FILE == rc || FR_NO_PATH == rc) ?
+           OS_ERROR_NOT_FOUND : IoError_get(OS_ERROR_GENERIC);
+}
+
+static OS_Error_t
+openMode(
+    const OS_FileSystem_OpenMode_t mode,
+    BYTE*                          oflags)
+{
+    switch (mode)
+    {
+    case OS_FileSystem_OpenMode_RDONLY:
+        *oflags = FA_READ;
+        break;
+    case OS_FileSystem_OpenMode_WRONLY:
+        *oflags = FA_WRITE;
+        break;
+    case OS_FileSystem_OpenMode_RDWR:
+        *oflags = FA_WRITE | FA_READ;
+        break;
+    default:
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+
+    return OS_SUCCESS;
+}
+
+static void
+clmt_release(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile)
+{
+    FatFs_File_t* file = self->files[hFile];
+
+    free(file->clmtHeap);
+    file->clmtHeap = NULL;
+    file->fh.cltbl = NULL;
+}
+
+/*
+ * Set up the cluster link map table of a file so seeks are resolved without
+ * following the cluster chain on the FAT. The table is taken from the pool
+ * first; if the file has too many fragments for it, a table of the required
+ * size is allocated. Without any table, FatFs falls back to walking the chain.
+ * Files without any cluster get no table, it is set up once they are accessed
+ * before their current position (see clmt_prepare()).
+ */
+static FRESULT
+clmt_build(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile)
+{
+    FCTX* fctx = &self->fs.fatFs.fctx;
+    FatFs_File_t* file = self->files[hFile];
+    FIL* fh = &file->fh;
+    DWORD* tbl = file->clmt;
+    DWORD size;
+    FRESULT rc;
+
+    clmt_release(self, hFile);
+
+    if (0 == fh->obj.sclust)
+    {
+        return FR_OK;
+    }
+
+    tbl[0] = OS_FILESYSTEM_FATFS_CLMT_SIZE;
+    fh->cltbl = tbl;
+    if ((rc = f_lseek(fctx, fh, CREATE_LINKMAP)) == FR_NOT_ENOUGH_CORE)
+    {
+        // FatFs has left the required number of items in the first one
+        size = tbl[0];
+        fh->cltbl = NULL;
+        if ((tbl = malloc(size * sizeof(DWORD))) == NULL)
+        {
+            Debug_LOG_DEBUG("Not using a link map table for file handle %d "
+                            "(%u items)", hFile, (unsigned int) size);
+            return FR_OK;
+        }
+        tbl[0] = size;
+        fh->cltbl = tbl;
+        file->clmtHeap = tbl;
+        rc = f_lseek(fctx, fh, CREATE_LINKMAP);
+    }
+
+    if (rc != FR_OK)
+    {
+        clmt_release(self, hFile);
+    }
+
+    return rc;
+}
+
+/*
+ * With a link map table, FatFs cannot seek beyond the end of a file, so the
+ * table is dropped before such a write. FatFs itself drops the table when an
+ * appended cluster starts a new fragment. In both cases the table is set up
+ * again once the file is accessed before its current position, which is where
+ * FatFs would have to walk the chain from the start anyway.
+ */
+static FRESULT
+clmt_prepare(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile,
+    const off_t                offset,
+    const bool                 write)
+{
+    FIL* fh = &((FatFs_File_t*) self->files[hFile])->fh;
+
+    if (write && (FSIZE_t)offset > f_size(fh))
+    {
+        fh->cltbl = NULL;
+    }
+    else if (NULL == fh->cltbl && (FSIZE_t)offset < f_tell(fh))
+    {
+        return clmt_build(self, hFile);
+    }
+
+    return FR_OK;
+}
+
+static OS_Error_t
+file_seek(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile,
+    const off_t                offset,
+    const bool                 write)
+{
+    FCTX* fctx = &self->fs.fatFs.fctx;
+    FIL* fh = &((FatFs_File_t*) self->files[hFile])->fh;
+    FRESULT rc;
+
+    if (OS_FileSystemFile_OFFSET_CURRENT == offset ||
+        f_tell(fh) == (FSIZE_t)offset)
+    {
+        return OS_SUCCESS;
+    }
+
+    if ((rc = clmt_prepare(self, hFile, offset, write)) != FR_OK ||
+        (rc = f_lseek(fctx, fh, offset)) != FR_OK)
+    {
+        Debug_LOG_ERROR("f_lseek() failed with %d on file handle %d",
+                        rc, hFile);
+        return IoError_get(OS_ERROR_ABORTED);
+    }
+
+    return OS_SUCCESS;
+}
+
 // Public Functions ------------------------------------------------------------
 
 OS_Error_t
@@ -30,23 +189,14 @@ FatFsFile_open(
     const OS_FileSystem_OpenFlags_t flags)
 {
     FCTX* fctx = &self->fs.fatFs.fctx;
-    FIL* fh = &self->fs.fatFs.fh[hFile];
+    FIL* fh = &((FatFs_File_t*) self->files[hFile])->fh;
     BYTE oflags;
+    OS_Error_t err;
     FRESULT rc;
 
-    switch (mode)
+    if ((err = openMode(mode, &oflags)) != OS_SUCCESS)
     {
-    case OS_FileSystem_OpenMode_RDONLY:
-        oflags = FA_READ;
-        break;
-    case OS_FileSystem_OpenMode_WRONLY:
-        oflags = FA_WRITE;
-        break;
-    case OS_FileSystem_OpenMode_RDWR:
-        oflags = FA_WRITE | FA_READ;
-        break;
-    default:
-        return OS_ERROR_INVALID_PARAMETER;
+        return err;
     }
     if (flags & OS_FileSystem_OpenFlags_CREATE)
     {
@@ -61,7 +211,71 @@ FatFsFile_open(
     if ((rc = f_open(fctx, fh, name, oflags)) != FR_OK)
     {
         Debug_LOG_ERROR("f_open() failed with %d on file name %s", rc, name);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
+        return lookupError(rc);
+    }
+
+    if ((rc = clmt_build(self, hFile)) != FR_OK)
+    {
+        Debug_LOG_ERROR("f_lseek() failed with %d on file name %s", rc, name);
+        f_close(fctx, fh);
+        return IoError_get(OS_ERROR_GENERIC);
+    }
+
+    return OS_SUCCESS;
+}
+
+OS_Error_t
+FatFsFile_openById(
+    OS_FileSystem_Handle_t         self,
+    OS_FileSystemFile_Handle_t     hFile,
+    const NameCache_Id_t*          id,
+    const OS_FileSystem_OpenMode_t mode)
+{
+    FCTX* fctx = &self->fs.fatFs.fctx;
+    FIL* fh = &((FatFs_File_t*) self->files[hFile])->fh;
+    BYTE oflags;
+    OS_Error_t err;
+    FRESULT rc;
+
+    if ((err = openMode(mode, &oflags)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    // The directory entry may have been reused since, FatFs checks its name
+    if ((rc = f_open_at(fctx, fh, &id->fatFs, oflags)) != FR_OK)
+    {
+        Debug_LOG_DEBUG("f_open_at() failed with %d on sector %u",
+                        rc, (unsigned int) id->fatFs.sect);
+        return lookupError(rc);
+    }
+
+    if ((rc = clmt_build(self, hFile)) != FR_OK)
+    {
+        Debug_LOG_ERROR("f_lseek() failed with %d on file handle %d",
+                        rc, hFile);
+        f_close(fctx, fh);
+        return IoError_get(OS_ERROR_GENERIC);
+    }
+
+    return OS_SUCCESS;
+}
+
+OS_Error_t
+FatFsFile_getId(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile,
+    NameCache_Id_t*            id)
+{
+    FCTX* fctx = &self->fs.fatFs.fctx;
+    FIL* fh = &((FatFs_File_t*) self->files[hFile])->fh;
+    FRESULT rc;
+
+    if ((rc = f_locate(fctx, fh, &id->fatFs)) != FR_OK)
+    {
+        Debug_LOG_ERROR("f_locate() failed with %d on file handle %d",
+                        rc, hFile);
+        return IoError_get(OS_ERROR_GENERIC);
     }
 
     return OS_SUCCESS;
@@ -73,74 +287,105 @@ FatFsFile_close(
     OS_FileSystemFile_Handle_t hFile)
 {
     FCTX* fctx = &self->fs.fatFs.fctx;
-    FIL* fh = &self->fs.fatFs.fh[hFile];
+    FIL* fh = &((FatFs_File_t*) self->files[hFile])->fh;
     FRESULT rc;
 
+    clmt_release(self, hFile);
+
     if ((rc = f_close(fctx, fh)) != FR_OK)
     {
         Debug_LOG_ERROR("f_close() failed with %d on file handle %d",
                         rc, hFile);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
+        return IoError_get(OS_ERROR_GENERIC);
     }
 
     return OS_SUCCESS;
 }
 
 OS_Error_t
-FatFsFile_read(
-    OS_FileSystem_Handle_t     self,
-    OS_FileSystemFile_Handle_t hFile,
-    const off_t                offset,
-    const size_t               len,
-    void*                      buffer)
+FatFsFile_readv(
+    OS_FileSystem_Handle_t           self,
+    OS_FileSystemFile_Handle_t       hFile,
+    const off_t                      offset,
+    const OS_FileSystemFile_IoVec_t* iov,
+    const size_t                     iovCount)
 {
     FCTX* fctx = &self->fs.fatFs.fctx;
-    FIL* fh = &self->fs.fatFs.fh[hFile];
+    FIL* fh = &((FatFs_File_t*) self->files[hFile])->fh;
     UINT read;
+    OS_Error_t err;
     FRESULT rc;
 
-    if ((rc = f_lseek(fctx, fh, offset)) != FR_OK)
+    if ((err = file_seek(self, hFile, offset, false)) != OS_SUCCESS)
     {
-        Debug_LOG_ERROR("f_lseek() failed with %d on file handle %d",
-                        rc, hFile);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_ABORTED;
+        return err;
     }
-    if ((rc = f_read(fctx, fh, buffer, len, &read)) != FR_OK)
+
+    for (size_t i = 0; i < iovCount; i++)
     {
-        Debug_LOG_ERROR("f_read() failed with %d on file handle %d",
-                        rc, hFile);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
+        if ((rc = f_read(fctx, fh, iov[i].buffer, iov[i].len,
+                         &read)) != FR_OK)
+        {
+            Debug_LOG_ERROR("f_read() failed with %d on file handle %d",
+                            rc, hFile);
+            return IoError_get(OS_ERROR_GENERIC);
+        }
     }
 
     return OS_SUCCESS;
 }
 
 OS_Error_t
-FatFsFile_write(
-    OS_FileSystem_Handle_t     self,
-    OS_FileSystemFile_Handle_t hFile,
-    const off_t                offset,
-    const size_t               len,
-    const void*                buffer)
+FatFsFile_writev(
+    OS_FileSystem_Handle_t           self,
+    OS_FileSystemFile_Handle_t       hFile,
+    const off_t                      offset,
+    const OS_FileSystemFile_IoVec_t* iov,
+    const size_t                     iovCount)
 {
     FCTX* fctx = &self->fs.fatFs.fctx;
-    FIL* fh = &self->fs.fatFs.fh[hFile];
+    FIL* fh = &((FatFs_File_t*) self->files[hFile])->fh;
     UINT written;
+    OS_Error_t err;
     FRESULT rc;
 
-    if ((rc = f_lseek(fctx, fh, offset)) != FR_OK)
+    if ((err = file_seek(self, hFile, offset, true)) != OS_SUCCESS)
     {
-        Debug_LOG_ERROR("f_lseek() failed with %d on file handle %d",
-                        rc, hFile);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_ABORTED;
+        return err;
     }
-    if ((rc = f_write(fctx, fh, buffer, len, &written)) != FR_OK)
+
+    for (size_t i = 0; i < iovCount; i++)
+    {
+        if ((rc = f_write(fctx, fh, iov[i].buffer, iov[i].len,
+                          &written)) != FR_OK)
+        {
+            Debug_LOG_ERROR("f_write() failed with %d on file handle %d",
+                            rc, hFile);
+            return IoError_get(OS_ERROR_GENERIC);
+        }
+    }
+
+    return OS_SUCCESS;
+}
+
+OS_Error_t
+FatFsFile_sync(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile)
+{
+    FCTX* fctx = &self->fs.fatFs.fctx;
+    FIL* fh = &((FatFs_File_t*) self->files[hFile])->fh;
+    FRESULT rc;
+
+    if ((rc = f_sync(fctx, fh)) != FR_OK)
     {
-        Debug_LOG_ERROR("f_write() failed with %d on file handle %d",
+        Debug_LOG_ERROR("f_sync() failed with %d on file handle %d",
                         rc, hFile);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
+        return IoError_get(OS_ERROR_GENERIC);
     }
 
+    // If the file was modified, f_sync() has flushed the block cache through
+    // CTRL_SYNC while holding the volume lock
     return OS_SUCCESS;
 }
 
@@ -156,7 +401,7 @@ FatFsFile_delete(
     {
         Debug_LOG_ERROR("f_unlink() failed with %d on file name %s",
                         rc, name);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
+        return lookupError(rc);
     }
 
     return OS_SUCCESS;
@@ -175,10 +420,45 @@ FatFsFile_getSize(
     if ((rc = f_stat(fctx, name, &fno)) != FR_OK)
     {
         Debug_LOG_ERROR("f_stat() failed with %d on file name %s", rc, name);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
+        return lookupError(rc);
+    }
+
+    *sz = fno.fsize;
+
+    return OS_SUCCESS;
+}
+
+OS_Error_t
+FatFsFile_getSizeById(
+    OS_FileSystem_Handle_t self,
+    const NameCache_Id_t*  id,
+    off_t*                 sz)
+{
+    FCTX* fctx = &self->fs.fatFs.fctx;
+    FILINFO fno;
+    FRESULT rc;
+
+    if ((rc = f_stat_at(fctx, &id->fatFs, &fno)) != FR_OK)
+    {
+        Debug_LOG_DEBUG("f_stat_at() failed with %d on sector %u",
+                        rc, (unsigned int) id->fatFs.sect);
+        return lookupError(rc);
     }
 
     *sz = fno.fsize;
 
     return OS_SUCCESS;
 }
+
+OS_Error_t
+FatFsFile_getSizeByHandle(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile,
+    off_t*                     sz)
+{
+    FIL* fh = &((FatFs_File_t*) self->files[hFile])->fh;
+
+    *sz = f_size(fh);
+
+    return OS_SUCCESS;
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#include "OS_FileSystem.h"
+
+#include "lib/HandleBitmap.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define BITS_PER_WORD   64
+#define WORD_FULL       UINT64_MAX
+
+// Private Functions -----------------------------------------------------------
+
+static inline uint64_t
+bit(
+    size_t index)
+{
+    return (uint64_t)1 << (index % BITS_PER_WORD);
+}
+
+static inline size_t
+words(
+    size_t bits)
+{
+    return (bits + BITS_PER_WORD - 1) / BITS_PER_WORD;
+}
+
+// Public Functions ------------------------------------------------------------
+
+OS_Error_t
+HandleBitmap_init(
+    HandleBitmap_t* self,
+    size_t          count)
+{
+    size_t i;
+
+    self->count = count;
+    self->words = words(count);
+
+    if ((self->used = calloc(self->words, sizeof(uint64_t))) == NULL)
+    {
+        return OS_ERROR_INSUFFICIENT_SPACE;
+    }
+    if ((self->full = calloc(words(self->words), sizeof(uint64_t))) == NULL)
+    {
+        free(self->used);
+        return OS_ERROR_INSUFFICIENT_SPACE;
+    }
+
+    // Bits beyond the last handle and beyond the last word are marked as used
+    // and full, respectively, so the scans never come up with them.
+    for (i = count; i < self->words * BITS_PER_WORD; i++)
+    {
+        self->used[i / BITS_PER_WORD] |= bit(i);
+    }
+    for (i = self->words; i < words(self->words) * BITS_PER_WORD; i++)
+    {
+        self->full[i / BITS_PER_WORD] |= bit(i);
+    }
+
+    return OS_SUCCESS;
+}
+
+void
+HandleBitmap_free(
+    HandleBitmap_t* self)
+{
+    free(self->used);
+    free(self->full);
+}
+
+size_t
+HandleBitmap_take(
+    HandleBitmap_t* self)
+{
+    size_t i, w, b;
+
+    for (i = 0; i < words(self->words); i++)
+    {
+        if (self->full[i] != WORD_FULL)
+        {
+            w = i * BITS_PER_WORD + __builtin_ctzll(~self->full[i]);
+            b = __builtin_ctzll(~self->used[w]);
+
+            self->used[w] |= bit(b);
+            if (self->used[w] == WORD_FULL)
+            {
+                self->full[w / BITS_PER_WORD] |= bit(w);
+            }
+
+            return w * BITS_PER_WORD + b;
+        }
+    }
+
+    return self->count;
+}
+
+void
+HandleBitmap_release(
+    HandleBitmap_t* self,
+    size_t          handle)
+{
+    size_t w = handle / BITS_PER_WORD;
+
+    self->used[w] &= ~bit(handle);
+    self->full[w / BITS_PER_WORD] &= ~bit(w);
+}
+
+bool
+HandleBitmap_inUse(
+    const HandleBitmap_t* self,
+    size_t                handle)
+{
+    return handle < self->count &&
+           (self->used[handle / BITS_PER_WORD] & bit(handle));
+}
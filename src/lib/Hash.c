@@ -0,0 +1,27 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#include "lib/Hash.h"
+
+#include <stdint.h>
+
+// Public Functions ------------------------------------------------------------
+
+uint32_t
+Hash_name(
+    const char* name)
+{
+    uint32_t hash = 2166136261u;
+
+    for (; *name != '\0'; name++)
+    {
+        hash = (hash ^ (uint8_t) *name) * 16777619u;
+    }
+
+    return hash;
+}
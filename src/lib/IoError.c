@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#include "OS_FileSystem.h"
+
+#include "lib/IoError.h"
+
+static _Thread_local OS_Error_t ioError = OS_SUCCESS;
+
+// Public Functions ------------------------------------------------------------
+
+void
+IoError_set(
+    OS_Error_t err)
+{
+    ioError = err;
+}
+
+void
+IoError_clear(void)
+{
+    ioError = OS_SUCCESS;
+}
+
+OS_Error_t
+IoError_get(
+    OS_Error_t fallback)
+{
+    OS_Error_t err = ioError;
+
+    if (OS_SUCCESS == err)
+    {
+        return fallback;
+    }
+
+    ioError = OS_SUCCESS;
+
+    return err;
+}
@@ -14,6 +14,9 @@
 #endif
 #include "lib_debug/Debug.h"
 
+#include "lib/IoError.h"
+#include "lib/Storage.h"
+
 #include "lfs.h"
 
 #include <stddef.h>
@@ -22,9 +25,14 @@
 #include <string.h>
 #include <inttypes.h>
 
-// Default configuration for LittleFS
+// Marks a LittleFS cache as invalid, see LFS_BLOCK_NULL in lfs.c
+#define LITTLEFS_BLOCK_NULL ((lfs_block_t) -1)
+
+// Default configuration for LittleFS; the lookahead bitmap has one bit per
+// block, by default it is sized to cover the whole file system within bounds
 #define LITTLEFS_DEFAULT_CACHE_SIZE 4096
-#define LITTLEFS_DEFAULT_LOOKAHEAD_SIZE 16
+#define LITTLEFS_MIN_LOOKAHEAD_SIZE 16
+#define LITTLEFS_MAX_LOOKAHEAD_SIZE 512
 static const OS_FileSystem_Format_t littleFs_defaultConfig =
 {
     .littleFs = {
@@ -37,6 +45,32 @@ static const OS_FileSystem_Format_t littleFs_defaultConfig =
 
 // Private Functions -----------------------------------------------------------
 
+static lfs_size_t
+defaultLookaheadSize(
+    lfs_size_t blockCount)
+{
+    // LittleFS requires the size to be a multiple of 8 bytes
+    lfs_size_t sz = ((blockCount + 63) / 64) * 8;
+
+    return (sz < LITTLEFS_MIN_LOOKAHEAD_SIZE) ? LITTLEFS_MIN_LOOKAHEAD_SIZE :
+           (sz > LITTLEFS_MAX_LOOKAHEAD_SIZE) ? LITTLEFS_MAX_LOOKAHEAD_SIZE : sz;
+}
+
+static void
+dropDataportCache(
+    OS_FileSystem_Handle_t self,
+    const void*            buffer)
+{
+    void* rbuf = self->fs.littleFs.cfg.read_buffer;
+
+    // If the read cache of LittleFS lives in the dataport (see LittleFs_init()),
+    // its content is lost once the dataport is used to transfer anything else.
+    if (rbuf == OS_Dataport_getBuf(self->cfg.storage.dataport) && rbuf != buffer)
+    {
+        self->fs.littleFs.fs.rcache.block = LITTLEFS_BLOCK_NULL;
+    }
+}
+
 static int
 storage_read(
     const struct lfs_config* c,
@@ -48,33 +82,16 @@ storage_read(
     OS_FileSystem_Handle_t self = (OS_FileSystem_Handle_t) c->context;
     OS_Error_t err;
     off_t addr;
-    size_t read;
 
-    if (size > OS_Dataport_getSize(self->cfg.storage.dataport))
-    {
-        self->ioError = OS_ERROR_BUFFER_TOO_SMALL;
-        return self->ioError;
-    }
+    dropDataportCache(self, buffer);
 
     addr = off + (c->block_size * block);
-    if ((err = self->cfg.storage.read(addr, size, &read)) != OS_SUCCESS)
-    {
-        Debug_LOG_ERROR("read() failed with %d", err);
-        self->ioError = err;
-        return self->ioError;
-    }
-
-    if (read != size)
+    if ((err = Storage_read(self, addr, size, buffer)) != OS_SUCCESS)
     {
-        Debug_LOG_ERROR("read() requested to read %d bytes but got %zu bytes",
-                        size, read);
-        self->ioError = OS_ERROR_ABORTED;
-        return self->ioError;
+        IoError_set(err);
+        return err;
     }
 
-    memcpy(buffer, OS_Dataport_getBuf(self->cfg.storage.dataport), read);
-
-    self->ioError = OS_SUCCESS;
     return 0;
 }
 
@@ -89,33 +106,16 @@ storage_prog(
     OS_FileSystem_Handle_t self = (OS_FileSystem_Handle_t) c->context;
     OS_Error_t err;
     off_t addr;
-    size_t written;
 
-    if (size > OS_Dataport_getSize(self->cfg.storage.dataport))
-    {
-        self->ioError = OS_ERROR_BUFFER_TOO_SMALL;
-        return self->ioError;
-    }
-
-    memcpy(OS_Dataport_getBuf(self->cfg.storage.dataport), buffer, size);
+    dropDataportCache(self, buffer);
 
     addr = off + (c->block_size * block);
-    if ((err = self->cfg.storage.write(addr, size, &written)) != OS_SUCCESS)
-    {
-        Debug_LOG_ERROR("write() failed with %d", err);
-        self->ioError = err;
-        return self->ioError;
-    }
-
-    if (written != size)
+    if ((err = Storage_write(self, addr, size, buffer)) != OS_SUCCESS)
     {
-        Debug_LOG_ERROR("write() requested to write %u bytes but got %zu bytes",
-                        size, written);
-        self->ioError = OS_ERROR_ABORTED;
-        return self->ioError;
+        IoError_set(err);
+        return err;
     }
 
-    self->ioError = OS_SUCCESS;
     return 0;
 }
 
@@ -126,30 +126,14 @@ storage_erase(
 {
     OS_FileSystem_Handle_t self = (OS_FileSystem_Handle_t) c->context;
     OS_Error_t err;
-    off_t addr;
-    off_t erased, size;
-
-    addr = c->block_size * block;
-    size = c->block_size;
-    if ((err = self->cfg.storage.erase(addr, size, &erased)) != OS_SUCCESS)
-    {
-        Debug_LOG_ERROR("erase() failed with %d", err);
-        self->ioError = err;
-        return self->ioError;
-    }
 
-    if (erased != size)
+    if ((err = Storage_erase(self, c->block_size * block,
+                             c->block_size)) != OS_SUCCESS)
     {
-        Debug_LOG_ERROR(
-            "erase() requested to erase %" PRIiMAX " bytes "
-            "but erased %" PRIiMAX " bytes",
-            size,
-            erased);
-        self->ioError = OS_ERROR_ABORTED;
-        return self->ioError;
+        IoError_set(err);
+        return err;
     }
 
-    self->ioError = OS_SUCCESS;
     return 0;
 }
 
@@ -157,11 +141,16 @@ static int
 storage_sync(
     const struct lfs_config* c)
 {
-    /*
-     * For now, we just assume writes are never cached so a sync() is not
-     * really necessary..
-     */
-    (void) c;
+    OS_FileSystem_Handle_t self = (OS_FileSystem_Handle_t) c->context;
+    OS_Error_t err;
+
+    // Writes are only held back if there is a block cache
+    if ((err = Storage_flush(self)) != OS_SUCCESS)
+    {
+        IoError_set(err);
+        return err;
+    }
+
     return 0;
 }
 
@@ -173,6 +162,7 @@ LittleFs_init(
 {
     OS_FileSystem_Config_t* cfg = &self->cfg;
     struct lfs_config* lfsCfg = &self->fs.littleFs.cfg;
+    const OS_FileSystem_ExtConfig_t* extCfg = &self->extCfg;
 
     // If user doesn't give us anything, we load some defaults
     if  (NULL == cfg->format)
@@ -181,8 +171,6 @@ LittleFs_init(
     }
 
     // Set storage specific options
-    lfsCfg->cache_size     = LITTLEFS_DEFAULT_CACHE_SIZE;
-    lfsCfg->lookahead_size = LITTLEFS_DEFAULT_LOOKAHEAD_SIZE;
     lfsCfg->read_size      = cfg->format->littleFs.readSize;
     lfsCfg->prog_size      = cfg->format->littleFs.writeSize;
     lfsCfg->block_size     = cfg->format->littleFs.blockSize;
@@ -199,6 +187,42 @@ LittleFs_init(
     }
     lfsCfg->block_count = cfg->size / cfg->format->littleFs.blockSize;
 
+    lfsCfg->cache_size = (extCfg->littleFs.cacheSize > 0) ?
+                         extCfg->littleFs.cacheSize :
+                         (lfsCfg->block_size < LITTLEFS_DEFAULT_CACHE_SIZE) ?
+                         lfsCfg->block_size : LITTLEFS_DEFAULT_CACHE_SIZE;
+    lfsCfg->lookahead_size = (extCfg->littleFs.lookaheadSize > 0) ?
+                             extCfg->littleFs.lookaheadSize :
+                             defaultLookaheadSize(lfsCfg->block_count);
+    if (lfsCfg->block_size % lfsCfg->cache_size ||
+        lfsCfg->cache_size % lfsCfg->read_size ||
+        lfsCfg->cache_size % lfsCfg->prog_size ||
+        lfsCfg->lookahead_size % 8)
+    {
+        Debug_LOG_ERROR("Cache size of %u bytes or lookahead size of %u bytes "
+                        "does not fit the block, read and write sizes",
+                        lfsCfg->cache_size, lfsCfg->lookahead_size);
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+
+    // Buffers not given by the user are allocated by LittleFS
+    lfsCfg->read_buffer      = extCfg->littleFs.readBuffer;
+    lfsCfg->prog_buffer      = extCfg->littleFs.progBuffer;
+    lfsCfg->lookahead_buffer = extCfg->littleFs.lookaheadBuffer;
+
+#if defined(OS_FILESYSTEM_USE_ZERO_COPY)
+    // Place the read cache directly in the dataport, so filling it takes just
+    // the storage call and no additional copy; this is not possible if the
+    // storage layer uses the dataport on its own behalf, which is known once
+    // it has been initialized.
+    if (NULL == lfsCfg->read_buffer &&
+        !Storage_sharesDataport(self) &&
+        lfsCfg->cache_size <= OS_Dataport_getSize(cfg->storage.dataport))
+    {
+        lfsCfg->read_buffer = OS_Dataport_getBuf(cfg->storage.dataport);
+    }
+#endif
+
     Debug_LOG_INFO("Using LITTLEFS ("
                    "cache_size = %u, "
                    "lookahead_size = %u, "
@@ -244,7 +268,7 @@ LittleFs_format(
     if ((rc = lfs_format(fs, cfg)) < 0)
     {
         Debug_LOG_ERROR("lfs_format() failed with %d", rc);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
+        return IoError_get(OS_ERROR_GENERIC);
     }
 
     return OS_SUCCESS;
@@ -261,12 +285,11 @@ LittleFs_mount(
     if ((rc = lfs_mount(fs, cfg)) < 0)
     {
         Debug_LOG_ERROR("lfs_mount() failed with %d", rc);
-        // If we have an ioError, return that; otherwise check if LittleFS
+        // If we have an I/O error, return that; otherwise check if LittleFS
         // complained about corruption, which we interpret as "wrong fs" and
         // return NOT_FOUND; otherwise return GENERIC.
-        return (self->ioError != OS_SUCCESS)
-               ? self->ioError : (rc == LFS_ERR_CORRUPT)
-               ? OS_ERROR_NOT_FOUND : OS_ERROR_GENERIC;
+        return IoError_get((rc == LFS_ERR_CORRUPT) ?
+                           OS_ERROR_NOT_FOUND : OS_ERROR_GENERIC);
     }
 
     return OS_SUCCESS;
@@ -282,8 +305,15 @@ LittleFs_unmount(
     if ((rc = lfs_unmount(fs)) < 0)
     {
         Debug_LOG_ERROR("lfs_unmount() failed with %d", rc);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
+        return IoError_get(OS_ERROR_GENERIC);
     }
 
     return OS_SUCCESS;
 }
+
+OS_Error_t
+LittleFs_wipe(
+    OS_FileSystem_Handle_t self)
+{
+    return Storage_wipe(self, (off_t) self->cfg.format->littleFs.blockSize);
+}
@@ -14,6 +14,9 @@
 #endif
 #include "lib_debug/Debug.h"
 
+#include "lib/IoError.h"
+#include "lib/Storage.h"
+
 #include "lfs.h"
 
 #include <stddef.h>
@@ -22,6 +25,52 @@
 
 // Private Functions -----------------------------------------------------------
 
+// Files which do not exist are told apart, so the name cache can note them
+static OS_Error_t
+lookupError(
+    const int rc)
+{
+    return (LFS_ERR_NOENT == rc) ?
+           OS_ERROR_NOT_FOUND : IoError_get(OS_ERROR_GENERIC);
+}
+
+static OS_Error_t
+file_seek(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile,
+    const off_t                offset)
+{
+    lfs_t* fs = &self->fs.littleFs.fs;
+    lfs_file_t* fh = &((LittleFs_File_t*) self->files[hFile])->fh;
+    lfs_soff_t off;
+
+    // Seeking flushes pending writes of the file, so it is only done if the
+    // file is not already at the requested position
+    if (OS_FileSystemFile_OFFSET_CURRENT == offset ||
+        lfs_file_tell(fs, fh) == offset)
+    {
+        return OS_SUCCESS;
+    }
+
+    if ((off = lfs_file_seek(fs, fh, offset, LFS_SEEK_SET)) < 0)
+    {
+        Debug_LOG_ERROR("lfs_file_seek() failed with %d", off);
+        return IoError_get(OS_ERROR_ABORTED);
+    }
+    if (off != offset)
+    {
+        Debug_LOG_ERROR(
+            "lfs_file_seek() jumped to offset %i instead of offset %" PRIiMAX,
+            off,
+            offset);
+        return OS_ERROR_ABORTED;
+    }
+
+    return OS_SUCCESS;
+}
+
+// Public Functions ------------------------------------------------------------
+
 OS_Error_t
 LittleFsFile_open(
     OS_FileSystem_Handle_t          self,
@@ -31,7 +80,8 @@ LittleFsFile_open(
     const OS_FileSystem_OpenFlags_t flags)
 {
     lfs_t* fs = &self->fs.littleFs.fs;
-    lfs_file_t* fh = &self->fs.littleFs.fh[hFile];
+    LittleFs_File_t* file = self->files[hFile];
+    uint8_t* buffers = self->extCfg.littleFs.fileBuffers;
     uint32_t oflags;
     int rc;
 
@@ -62,10 +112,16 @@ LittleFsFile_open(
         oflags |= LFS_O_TRUNC;
     }
 
-    if ((rc = lfs_file_open(fs, fh, name, oflags)) < 0)
+    // Without a buffer given by the user, LittleFS allocates the file cache
+    if (NULL != buffers)
     {
-        Debug_LOG_ERROR("lfs_file_open() failed with %d", rc);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
+        file->cfg.buffer = &buffers[hFile * self->fs.littleFs.cfg.cache_size];
+    }
+
+    if ((rc = lfs_file_opencfg(fs, &file->fh, name, oflags, &file->cfg)) < 0)
+    {
+        Debug_LOG_ERROR("lfs_file_opencfg() failed with %d", rc);
+        return lookupError(rc);
     }
 
     return OS_SUCCESS;
@@ -77,100 +133,108 @@ LittleFsFile_close(
     OS_FileSystemFile_Handle_t hFile)
 {
     lfs_t* fs = &self->fs.littleFs.fs;
-    lfs_file_t* fh = &self->fs.littleFs.fh[hFile];
+    lfs_file_t* fh = &((LittleFs_File_t*) self->files[hFile])->fh;
     int rc;
 
     if ((rc = lfs_file_close(fs, fh)) < 0)
     {
         Debug_LOG_ERROR("lfs_file_close() failed with %d", rc);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
+        return IoError_get(OS_ERROR_GENERIC);
     }
 
     return OS_SUCCESS;
 }
 
 OS_Error_t
-LittleFsFile_read(
-    OS_FileSystem_Handle_t     self,
-    OS_FileSystemFile_Handle_t hFile,
-    const off_t                offset,
-    const size_t               len,
-    void*                      buffer)
+LittleFsFile_readv(
+    OS_FileSystem_Handle_t           self,
+    OS_FileSystemFile_Handle_t       hFile,
+    const off_t                      offset,
+    const OS_FileSystemFile_IoVec_t* iov,
+    const size_t                     iovCount)
 {
     lfs_t* fs = &self->fs.littleFs.fs;
-    lfs_file_t* fh = &self->fs.littleFs.fh[hFile];
+    lfs_file_t* fh = &((LittleFs_File_t*) self->files[hFile])->fh;
     lfs_ssize_t sz;
-    lfs_soff_t off;
+    OS_Error_t err;
 
-    if ((off = lfs_file_seek(fs, fh, offset, LFS_SEEK_SET)) < 0)
+    if ((err = file_seek(self, hFile, offset)) != OS_SUCCESS)
     {
-        Debug_LOG_ERROR("lfs_file_seek() failed with %d", off);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_ABORTED;
-    }
-    if (off != offset)
-    {
-        Debug_LOG_ERROR(
-            "lfs_file_seek() jumped to offset %i instead of offset %" PRIiMAX,
-            off,
-            offset);
-        return OS_ERROR_ABORTED;
+        return err;
     }
 
-    if ((sz = lfs_file_read(fs, fh, buffer, len)) < 0)
-    {
-        Debug_LOG_ERROR("lfs_file_read() failed with %d", sz);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
-    }
-    if (sz != len)
+    for (size_t i = 0; i < iovCount; i++)
     {
-        Debug_LOG_ERROR("lfs_file_read() read %i bytes instead of %zu bytes",
-                        sz, len);
-        return OS_ERROR_ABORTED;
+        if ((sz = lfs_file_read(fs, fh, iov[i].buffer, iov[i].len)) < 0)
+        {
+            Debug_LOG_ERROR("lfs_file_read() failed with %d", sz);
+            return IoError_get(OS_ERROR_GENERIC);
+        }
+        if (sz != iov[i].len)
+        {
+            Debug_LOG_ERROR("lfs_file_read() read %i bytes instead of %zu bytes",
+                            sz, iov[i].len);
+            return OS_ERROR_ABORTED;
+        }
     }
 
     return OS_SUCCESS;
 }
 
 OS_Error_t
-LittleFsFile_write(
-    OS_FileSystem_Handle_t     self,
-    OS_FileSystemFile_Handle_t hFile,
-    const off_t                offset,
-    const size_t               len,
-    const void*                buffer)
+LittleFsFile_writev(
+    OS_FileSystem_Handle_t           self,
+    OS_FileSystemFile_Handle_t       hFile,
+    const off_t                      offset,
+    const OS_FileSystemFile_IoVec_t* iov,
+    const size_t                     iovCount)
 {
     lfs_t* fs = &self->fs.littleFs.fs;
-    lfs_file_t* fh = &self->fs.littleFs.fh[hFile];
+    lfs_file_t* fh = &((LittleFs_File_t*) self->files[hFile])->fh;
     lfs_ssize_t sz;
-    lfs_soff_t off;
+    OS_Error_t err;
 
-    if ((off = lfs_file_seek(fs, fh, offset, LFS_SEEK_SET)) < 0)
+    if ((err = file_seek(self, hFile, offset)) != OS_SUCCESS)
     {
-        Debug_LOG_ERROR("lfs_file_seek() failed with %d", off);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_ABORTED;
-    }
-    if (off != offset)
-    {
-        Debug_LOG_ERROR(
-            "lfs_file_seek() jumped to offset %i instead of offset %" PRIiMAX,
-            off,
-            offset);
-        return OS_ERROR_ABORTED;
+        return err;
     }
 
-    if ((sz = lfs_file_write(fs, fh, buffer, len)) < 0)
+    for (size_t i = 0; i < iovCount; i++)
     {
-        Debug_LOG_ERROR("lfs_file_write() failed with %d", sz);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
+        if ((sz = lfs_file_write(fs, fh, iov[i].buffer, iov[i].len)) < 0)
+        {
+            Debug_LOG_ERROR("lfs_file_write() failed with %d", sz);
+            return IoError_get(OS_ERROR_GENERIC);
+        }
+        if (sz != iov[i].len)
+        {
+            Debug_LOG_ERROR("lfs_file_write() wrote %i bytes instead of "
+                            "%zu bytes", sz, iov[i].len);
+            return OS_ERROR_ABORTED;
+        }
     }
-    if (sz != len)
+
+    return OS_SUCCESS;
+}
+
+OS_Error_t
+LittleFsFile_sync(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile)
+{
+    lfs_t* fs = &self->fs.littleFs.fs;
+    lfs_file_t* fh = &((LittleFs_File_t*) self->files[hFile])->fh;
+    int rc;
+
+    if ((rc = lfs_file_sync(fs, fh)) < 0)
     {
-        Debug_LOG_ERROR("lfs_file_write() wrote %i bytes instead of %zu bytes",
-                        sz, len);
-        return OS_ERROR_ABORTED;
+        Debug_LOG_ERROR("lfs_file_sync() failed with %d", rc);
+        return IoError_get(OS_ERROR_GENERIC);
     }
 
-    return OS_SUCCESS;
+    // Data of the file which was written before may still be in the block
+    // cache even if the backend has nothing left to do for the file
+    return Storage_flush(self);
 }
 
 OS_Error_t
@@ -184,7 +248,7 @@ LittleFsFile_delete(
     if ((rc = lfs_remove(fs, name)) < 0)
     {
         Debug_LOG_ERROR("lfs_remove() failed with %d", rc);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
+        return lookupError(rc);
     }
 
     return OS_SUCCESS;
@@ -197,20 +261,43 @@ LittleFsFile_getSize(
     off_t*                 sz)
 {
     lfs_t* fs = &self->fs.littleFs.fs;
-    lfs_file_t fh;
+    struct lfs_info info;
     int rc;
 
-    if ((rc = lfs_file_open(fs, &fh, name, LFS_O_RDONLY)) < 0)
+    // The entry of the file holds its size, it does not need to be opened
+    if ((rc = lfs_stat(fs, name, &info)) < 0)
     {
-        Debug_LOG_ERROR("lfs_file_open() failed with %d", rc);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
+        Debug_LOG_ERROR("lfs_stat() failed with %d", rc);
+        return lookupError(rc);
     }
-    *sz = lfs_file_size(fs, &fh);
-    if ((rc = lfs_file_close(fs, &fh)) < 0)
+    if (info.type != LFS_TYPE_REG)
     {
-        Debug_LOG_ERROR("lfs_file_close() failed with %d", rc);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_ABORTED;
+        Debug_LOG_ERROR("%s is not a file", name);
+        return OS_ERROR_GENERIC;
+    }
+
+    *sz = info.size;
+
+    return OS_SUCCESS;
+}
+
+OS_Error_t
+LittleFsFile_getSizeByHandle(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile,
+    off_t*                     sz)
+{
+    lfs_t* fs = &self->fs.littleFs.fs;
+    lfs_file_t* fh = &((LittleFs_File_t*) self->files[hFile])->fh;
+    lfs_soff_t rc;
+
+    if ((rc = lfs_file_size(fs, fh)) < 0)
+    {
+        Debug_LOG_ERROR("lfs_file_size() failed with %d", (int) rc);
+        return IoError_get(OS_ERROR_GENERIC);
     }
 
+    *sz = rc;
+
     return OS_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#include "OS_FileSystem.h"
+#include "OS_FileSystem_int.h"
+
+#include "lib/Lock.h"
+
+#if defined(OS_FILESYSTEM_REMOVE_DEBUG_LOGGING)
+#undef Debug_Config_PRINT_TO_LOG_SERVER
+#endif
+#include "lib_debug/Debug.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+
+// Private Functions -----------------------------------------------------------
+
+static void*
+lock_create(
+    OS_FileSystem_Handle_t self)
+{
+    return self->extCfg.lock.create(self->extCfg.lock.ctx);
+}
+
+static void
+lock_destroy(
+    OS_FileSystem_Handle_t self,
+    void*                  lock)
+{
+    if (NULL != lock)
+    {
+        self->extCfg.lock.destroy(self->extCfg.lock.ctx, lock);
+    }
+}
+
+// Public Functions ------------------------------------------------------------
+
+OS_Error_t
+Lock_init(
+    OS_FileSystem_Handle_t self)
+{
+    const OS_FileSystem_ExtConfig_t* extCfg = &self->extCfg;
+    Lock_t* locks = &self->lock;
+
+    if (NULL == extCfg->lock.create && NULL == extCfg->lock.destroy &&
+        NULL == extCfg->lock.acquire && NULL == extCfg->lock.release)
+    {
+        return OS_SUCCESS;
+    }
+    if (NULL == extCfg->lock.create || NULL == extCfg->lock.destroy ||
+        NULL == extCfg->lock.acquire || NULL == extCfg->lock.release)
+    {
+        Debug_LOG_ERROR("Locking requires all lock callbacks");
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+
+    if ((locks->files = calloc(self->handles.count, sizeof(void*))) == NULL)
+    {
+        return OS_ERROR_INSUFFICIENT_SPACE;
+    }
+
+    locks->instance = lock_create(self);
+    locks->backend  = lock_create(self);
+    locks->queue    = lock_create(self);
+    if (NULL == locks->instance || NULL == locks->backend ||
+        NULL == locks->queue)
+    {
+        Lock_free(self);
+        return OS_ERROR_INSUFFICIENT_SPACE;
+    }
+
+    return OS_SUCCESS;
+}
+
+void
+Lock_free(
+    OS_FileSystem_Handle_t self)
+{
+    Lock_t* locks = &self->lock;
+
+    if (NULL == locks->files)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < self->handles.count; i++)
+    {
+        lock_destroy(self, locks->files[i]);
+    }
+    free(locks->files);
+    lock_destroy(self, locks->instance);
+    lock_destroy(self, locks->backend);
+    lock_destroy(self, locks->queue);
+
+    *locks = (Lock_t) { 0 };
+}
+
+OS_Error_t
+Lock_createFile(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile)
+{
+    if (NULL == self->lock.files)
+    {
+        return OS_SUCCESS;
+    }
+
+    return ((self->lock.files[hFile] = lock_create(self)) == NULL) ?
+           OS_ERROR_INSUFFICIENT_SPACE : OS_SUCCESS;
+}
+
+void
+Lock_destroyFile(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile)
+{
+    if (NULL == self->lock.files)
+    {
+        return;
+    }
+
+    lock_destroy(self, self->lock.files[hFile]);
+    self->lock.files[hFile] = NULL;
+}
+
+OS_Error_t
+Lock_acquire(
+    OS_FileSystem_Handle_t self,
+    void*                  lock,
+    bool                   exclusive)
+{
+    OS_Error_t err;
+
+    if (NULL == lock)
+    {
+        return OS_SUCCESS;
+    }
+
+    if ((err = self->extCfg.lock.acquire(self->extCfg.lock.ctx, lock,
+                                         exclusive)) != OS_SUCCESS)
+    {
+        Debug_LOG_ERROR("acquire() failed with %d", err);
+    }
+
+    return err;
+}
+
+void
+Lock_release(
+    OS_FileSystem_Handle_t self,
+    void*                  lock,
+    bool                   exclusive)
+{
+    if (NULL != lock)
+    {
+        self->extCfg.lock.release(self->extCfg.lock.ctx, lock, exclusive);
+    }
+}
@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#include "OS_FileSystem.h"
+#include "OS_FileSystem_int.h"
+
+#include "lib/Hash.h"
+#include "lib/NameCache.h"
+
+#if defined(OS_FILESYSTEM_REMOVE_DEBUG_LOGGING)
+#undef Debug_Config_PRINT_TO_LOG_SERVER
+#endif
+#include "lib_debug/Debug.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Private Functions -----------------------------------------------------------
+
+static NameCache_Entry_t*
+entry_find(
+    NameCache_t*   nc,
+    const char*    name,
+    const uint32_t hash)
+{
+    NameCache_Entry_t* set = &nc->entries[(hash % nc->sets) * NameCache_WAYS];
+
+    for (size_t i = 0; i < NameCache_WAYS; i++)
+    {
+        if (set[i].name[0] != '\0' && set[i].hash == hash &&
+            strcmp(set[i].name, name) == 0)
+        {
+            return &set[i];
+        }
+    }
+
+    return NULL;
+}
+
+// Take an unused entry of the set, or the least recently used one
+static NameCache_Entry_t*
+entry_take(
+    NameCache_t*   nc,
+    const uint32_t hash)
+{
+    NameCache_Entry_t* set = &nc->entries[(hash % nc->sets) * NameCache_WAYS];
+    NameCache_Entry_t* victim = &set[0];
+
+    for (size_t i = 0; i < NameCache_WAYS; i++)
+    {
+        if (set[i].name[0] == '\0')
+        {
+            return &set[i];
+        }
+        if ((int32_t)(set[i].used - victim->used) < 0)
+        {
+            victim = &set[i];
+        }
+    }
+
+    return victim;
+}
+
+// Public Functions ------------------------------------------------------------
+
+OS_Error_t
+NameCache_init(
+    OS_FileSystem_Handle_t self)
+{
+    NameCache_t* nc = &self->nameCache;
+    const size_t sets = (self->extCfg.nameCache.entries + NameCache_WAYS - 1) /
+                        NameCache_WAYS;
+
+    if (0 == sets)
+    {
+        return OS_SUCCESS;
+    }
+
+    if ((nc->entries = calloc(sets * NameCache_WAYS,
+                              sizeof(NameCache_Entry_t))) == NULL)
+    {
+        return OS_ERROR_INSUFFICIENT_SPACE;
+    }
+
+    nc->sets = sets;
+
+    Debug_LOG_INFO("Caching up to %zu file names", sets * NameCache_WAYS);
+
+    return OS_SUCCESS;
+}
+
+void
+NameCache_free(
+    OS_FileSystem_Handle_t self)
+{
+    NameCache_t* nc = &self->nameCache;
+
+    free(nc->entries);
+    memset(nc, 0, sizeof(NameCache_t));
+}
+
+bool
+NameCache_isEnabled(
+    OS_FileSystem_Handle_t self)
+{
+    return self->nameCache.sets > 0;
+}
+
+NameCache_State_t
+NameCache_lookup(
+    OS_FileSystem_Handle_t self,
+    const char*            name,
+    NameCache_Id_t*        id)
+{
+    NameCache_t* nc = &self->nameCache;
+    NameCache_Entry_t* entry;
+
+    if (0 == nc->sets ||
+        (entry = entry_find(nc, name, Hash_name(name))) == NULL)
+    {
+        return NameCache_State_UNKNOWN;
+    }
+
+    entry->used = ++nc->clock;
+    if (!entry->found)
+    {
+        return NameCache_State_MISSING;
+    }
+
+    memcpy(id, &entry->id, sizeof(NameCache_Id_t));
+
+    return NameCache_State_FOUND;
+}
+
+void
+NameCache_insert(
+    OS_FileSystem_Handle_t self,
+    const char*            name,
+    const NameCache_Id_t*  id)
+{
+    NameCache_t* nc = &self->nameCache;
+    NameCache_Entry_t* entry;
+    uint32_t hash;
+
+    if (0 == nc->sets ||
+        strnlen(name, OS_FILESYSTEM_NAME_CACHE_NAME_LEN) ==
+        OS_FILESYSTEM_NAME_CACHE_NAME_LEN)
+    {
+        return;
+    }
+
+    hash = Hash_name(name);
+    if ((entry = entry_find(nc, name, hash)) == NULL)
+    {
+        entry = entry_take(nc, hash);
+        strcpy(entry->name, name);
+        entry->hash = hash;
+    }
+
+    // Identities are compared as a whole, so they are copied with padding
+    entry->used  = ++nc->clock;
+    entry->found = (NULL != id);
+    if (NULL != id)
+    {
+        memcpy(&entry->id, id, sizeof(NameCache_Id_t));
+    }
+}
+
+void
+NameCache_remove(
+    OS_FileSystem_Handle_t self,
+    const char*            name)
+{
+    NameCache_t* nc = &self->nameCache;
+    NameCache_Entry_t* entry;
+
+    if (0 != nc->sets &&
+        (entry = entry_find(nc, name, Hash_name(name))) != NULL)
+    {
+        entry->name[0] = '\0';
+    }
+}
+
+/*
+ * A new file may be found under names which were missing so far, as the
+ * backends may not tell names apart which differ only in case or in the
+ * separators. Entries of the identity of the new file belong to a deleted
+ * file which was known by another name.
+ */
+void
+NameCache_create(
+    OS_FileSystem_Handle_t self,
+    const char*            name,
+    const NameCache_Id_t*  id)
+{
+    NameCache_t* nc = &self->nameCache;
+    NameCache_Entry_t* entry;
+
+    for (size_t i = 0; i < nc->sets * NameCache_WAYS; i++)
+    {
+        entry = &nc->entries[i];
+        if (!entry->found || (NULL != id &&
+                              memcmp(&entry->id, id,
+                                     sizeof(NameCache_Id_t)) == 0))
+        {
+            entry->name[0] = '\0';
+        }
+    }
+
+    if (NULL != id)
+    {
+        NameCache_insert(self, name, id);
+    }
+    else
+    {
+        NameCache_remove(self, name);
+    }
+}
+
+void
+NameCache_clear(
+    OS_FileSystem_Handle_t self)
+{
+    NameCache_t* nc = &self->nameCache;
+
+    if (0 != nc->sets)
+    {
+        memset(nc->entries, 0,
+               nc->sets * NameCache_WAYS * sizeof(NameCache_Entry_t));
+    }
+}
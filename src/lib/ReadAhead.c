@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#include "OS_FileSystem.h"
+#include "OS_FileSystem_int.h"
+
+#include "lib/ReadAhead.h"
+
+#if defined(OS_FILESYSTEM_REMOVE_DEBUG_LOGGING)
+#undef Debug_Config_PRINT_TO_LOG_SERVER
+#endif
+#include "lib_debug/Debug.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The window starts at this fraction of the buffer and doubles with each
+// sequential read
+#define WINDOW_INITIAL_SHIFT    2
+
+#define HINT_NONE               0
+#define HINT_SEQUENTIAL         1
+#define HINT_RANDOM             2
+
+// Window of the read the calling thread is doing
+static _Thread_local size_t window;
+
+// Public Functions ------------------------------------------------------------
+
+OS_Error_t
+ReadAhead_init(
+    OS_FileSystem_Handle_t self)
+{
+    ReadAhead_t* ra = &self->readAhead;
+    size_t size = self->extCfg.readAhead.size;
+    size_t maxSize = OS_Dataport_getSize(self->cfg.storage.dataport);
+
+    if (0 == size)
+    {
+        return OS_SUCCESS;
+    }
+
+    // A single storage call fills the buffer
+    size = (size > maxSize) ? maxSize : size;
+
+    ra->buffer = malloc(size);
+    ra->files  = calloc(self->handles.count, sizeof(ReadAhead_File_t));
+    if (NULL == ra->buffer || NULL == ra->files)
+    {
+        ReadAhead_free(self);
+        return OS_ERROR_INSUFFICIENT_SPACE;
+    }
+
+    ra->size = size;
+
+    Debug_LOG_INFO("Using read-ahead of up to %zu bytes", size);
+
+    return OS_SUCCESS;
+}
+
+void
+ReadAhead_free(
+    OS_FileSystem_Handle_t self)
+{
+    ReadAhead_t* ra = &self->readAhead;
+
+    free(ra->buffer);
+    free(ra->files);
+
+    memset(ra, 0, sizeof(ReadAhead_t));
+}
+
+void
+ReadAhead_open(
+    OS_FileSystem_Handle_t          self,
+    OS_FileSystemFile_Handle_t      hFile,
+    const OS_FileSystem_OpenFlags_t flags)
+{
+    ReadAhead_t* ra = &self->readAhead;
+    ReadAhead_File_t* file;
+
+    if (0 == ra->size)
+    {
+        return;
+    }
+
+    file = &ra->files[hFile];
+    file->next   = 0;
+    file->window = 0;
+    file->hint   = (flags & OS_FileSystem_OpenFlags_SEQUENTIAL) ?
+                   HINT_SEQUENTIAL :
+                   (flags & OS_FileSystem_OpenFlags_RANDOM) ?
+                   HINT_RANDOM : HINT_NONE;
+}
+
+void
+ReadAhead_begin(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile,
+    const off_t                offset)
+{
+    ReadAhead_t* ra = &self->readAhead;
+    ReadAhead_File_t* file;
+
+    if (0 == ra->size)
+    {
+        return;
+    }
+
+    file = &ra->files[hFile];
+    if (HINT_RANDOM == file->hint)
+    {
+        file->window = 0;
+    }
+    else if (HINT_SEQUENTIAL == file->hint)
+    {
+        file->window = ra->size;
+    }
+    else if (OS_FileSystemFile_OFFSET_CURRENT == offset ||
+             offset == file->next)
+    {
+        file->window = (0 == file->window) ?
+                       ra->size >> WINDOW_INITIAL_SHIFT :
+                       file->window << 1;
+        file->window = (file->window > ra->size) ? ra->size : file->window;
+    }
+    else
+    {
+        file->window = 0;
+    }
+
+    window = file->window;
+}
+
+void
+ReadAhead_end(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile,
+    const off_t                offset,
+    const size_t               len,
+    const OS_Error_t           err)
+{
+    ReadAhead_t* ra = &self->readAhead;
+    ReadAhead_File_t* file;
+
+    window = 0;
+
+    if (0 == ra->size)
+    {
+        return;
+    }
+
+    // After a failed read, the position of the file is not known
+    file = &ra->files[hFile];
+    if (err != OS_SUCCESS)
+    {
+        file->next = -1;
+    }
+    else if (offset != OS_FileSystemFile_OFFSET_CURRENT)
+    {
+        file->next = offset + len;
+    }
+    else if (file->next >= 0)
+    {
+        file->next += len;
+    }
+}
+
+OS_Error_t
+ReadAhead_read(
+    OS_FileSystem_Handle_t self,
+    off_t                  addr,
+    size_t                 size,
+    void*                  buffer,
+    ReadAhead_Read_t       read)
+{
+    ReadAhead_t* ra = &self->readAhead;
+    uint8_t* buf = buffer;
+    OS_Error_t err;
+    size_t off, len;
+
+    while (size > 0)
+    {
+        if (addr >= ra->addr && addr < ra->addr + (off_t) ra->len)
+        {
+            off = addr - ra->addr;
+            len = ra->len - off;
+            len = (len > size) ? size : len;
+            memcpy(buf, ra->buffer + off, len);
+        }
+        else if (size >= window)
+        {
+            // Large enough on its own
+            return read(self, addr, size, buf);
+        }
+        else
+        {
+            len = (addr + (off_t) window > self->cfg.size) ?
+                  self->cfg.size - addr : window;
+            ra->len = 0;
+            if ((err = read(self, addr, len, ra->buffer)) != OS_SUCCESS)
+            {
+                return err;
+            }
+            ra->addr = addr;
+            ra->len  = len;
+            continue;
+        }
+
+        buf  += len;
+        addr += len;
+        size -= len;
+    }
+
+    return OS_SUCCESS;
+}
+
+void
+ReadAhead_invalidate(
+    OS_FileSystem_Handle_t self,
+    const off_t            addr,
+    const off_t            size)
+{
+    ReadAhead_t* ra = &self->readAhead;
+
+    if (addr < ra->addr + (off_t) ra->len && addr + size > ra->addr)
+    {
+        ra->len = 0;
+    }
+}
+
+void
+ReadAhead_reset(
+    OS_FileSystem_Handle_t self)
+{
+    ReadAhead_t* ra = &self->readAhead;
+
+    if (0 == ra->size)
+    {
+        return;
+    }
+
+    memset(ra->files, 0, self->handles.count * sizeof(ReadAhead_File_t));
+    ra->len = 0;
+}
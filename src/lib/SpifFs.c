@@ -14,6 +14,11 @@
 #endif
 #include "lib_debug/Debug.h"
 
+#include "lib/IoError.h"
+#include "lib/SpifFsIndex.h"
+#include "lib/Storage.h"
+
+#include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
 
@@ -43,32 +48,13 @@ storage_read(
 {
     OS_FileSystem_Handle_t self = (OS_FileSystem_Handle_t)fs->user_data;
     OS_Error_t err;
-    size_t read;
 
-    if (size > OS_Dataport_getSize(self->cfg.storage.dataport))
+    if ((err = Storage_read(self, addr, size, dst)) != OS_SUCCESS)
     {
-        self->ioError = OS_ERROR_BUFFER_TOO_SMALL;
-        return self->ioError;
+        IoError_set(err);
+        return err;
     }
 
-    if ((err = self->cfg.storage.read(addr, size, &read)) != OS_SUCCESS)
-    {
-        Debug_LOG_ERROR("read() failed with %d", err);
-        self->ioError = err;
-        return self->ioError;
-    }
-
-    if (read != size)
-    {
-        Debug_LOG_ERROR("read() requested to read %u bytes but got %zu bytes",
-                        size, read);
-        self->ioError = OS_ERROR_ABORTED;
-        return self->ioError;
-    }
-
-    memcpy(dst, OS_Dataport_getBuf(self->cfg.storage.dataport), read);
-
-    self->ioError = OS_SUCCESS;
     return OS_SUCCESS;
 }
 
@@ -81,32 +67,13 @@ storage_write(
 {
     OS_FileSystem_Handle_t self = (OS_FileSystem_Handle_t)fs->user_data;
     OS_Error_t err;
-    size_t written;
-
-    if (size > OS_Dataport_getSize(self->cfg.storage.dataport))
-    {
-        self->ioError = OS_ERROR_BUFFER_TOO_SMALL;
-        return self->ioError;
-    }
-
-    memcpy(OS_Dataport_getBuf(self->cfg.storage.dataport), src, size);
 
-    if ((err = self->cfg.storage.write(addr, size, &written)) != OS_SUCCESS)
+    if ((err = Storage_write(self, addr, size, src)) != OS_SUCCESS)
     {
-        Debug_LOG_ERROR("write() failed with %d", err);
-        self->ioError = err;
-        return self->ioError;
+        IoError_set(err);
+        return err;
     }
 
-    if (written != size)
-    {
-        Debug_LOG_ERROR("write() requested to write %u bytes but got %zu bytes",
-                        size, written);
-        self->ioError = OS_ERROR_ABORTED;
-        return self->ioError;
-    }
-
-    self->ioError = OS_SUCCESS;
     return OS_SUCCESS;
 }
 
@@ -118,26 +85,13 @@ storage_erase(
 {
     OS_FileSystem_Handle_t self = (OS_FileSystem_Handle_t)fs->user_data;
     OS_Error_t err;
-    off_t erased;
-
-    if ((err = self->cfg.storage.erase(addr, size, &erased)) != OS_SUCCESS)
-    {
-        Debug_LOG_ERROR("erase() failed with %d", err);
-        self->ioError = err;
-        return self->ioError;
-    }
 
-    if (erased != size)
+    if ((err = Storage_erase(self, addr, size)) != OS_SUCCESS)
     {
-        Debug_LOG_ERROR(
-            "erase() requested to erase %u bytes but erased %" PRIiMAX " bytes",
-            size,
-            erased);
-        self->ioError = OS_ERROR_ABORTED;
-        return self->ioError;
+        IoError_set(err);
+        return err;
     }
 
-    self->ioError = OS_SUCCESS;
     return OS_SUCCESS;
 }
 
@@ -208,10 +162,21 @@ SpifFs_init(
         goto err0;
     }
 
+    // SPIFFS takes the space for its file descriptors at mount time, so it is
+    // allocated for all handles up front
+    self->fs.spifFs.fds = calloc(self->handles.count, sizeof(spiffs_fd));
+    if (self->fs.spifFs.fds == NULL)
+    {
+        err = OS_ERROR_INSUFFICIENT_SPACE;
+        goto err1;
+    }
+
     self->fs.spifFs.fs.user_data = (void *)self;
 
     return OS_SUCCESS;
 
+err1:
+    free(self->fs.spifFs.workBuf);
 err0:
     free(self->fs.spifFs.cacheBuf);
     return err;
@@ -221,8 +186,11 @@ OS_Error_t
 SpifFs_free(
     OS_FileSystem_Handle_t self)
 {
+    SpifFsIndex_clear(self);
+
     free(self->fs.spifFs.cacheBuf);
     free(self->fs.spifFs.workBuf);
+    free(self->fs.spifFs.fds);
 
     return OS_SUCCESS;
 }
@@ -235,11 +203,13 @@ SpifFs_format(
     spiffs_config *cfg = &self->fs.spifFs.cfg;
     int rc;
 
+    SpifFsIndex_clear(self);
+
     // SPIFFS_format needs to be called with an initalized spiffs structure,
     // the initialization of which happens in SPIFFS_mount.
     rc = SPIFFS_mount(fs, cfg, self->fs.spifFs.workBuf,
                       self->fs.spifFs.fds,
-                      sizeof(self->fs.spifFs.fds),
+                      self->handles.count * sizeof(spiffs_fd),
                       self->fs.spifFs.cacheBuf,
                       self->fs.spifFs.cacheSize, NULL);
 
@@ -251,7 +221,7 @@ SpifFs_format(
     if ((rc = SPIFFS_format(fs)) < 0)
     {
         Debug_LOG_ERROR("SPIFFS_format() failed with %d", rc);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
+        return IoError_get(OS_ERROR_GENERIC);
     }
 
     return OS_SUCCESS;
@@ -267,19 +237,24 @@ SpifFs_mount(
 
     if ((rc = SPIFFS_mount(fs, cfg, self->fs.spifFs.workBuf,
                            self->fs.spifFs.fds,
-                           sizeof(self->fs.spifFs.fds),
+                           self->handles.count * sizeof(spiffs_fd),
                            self->fs.spifFs.cacheBuf,
                            self->fs.spifFs.cacheSize, NULL)) < 0)
     {
         Debug_LOG_ERROR("SPIFFS_mount() failed with %d", rc);
-        // If we have an ioError, return that; otherwise check if spiffs
+        // If we have an I/O error, return that; otherwise check if spiffs
         // complained about it not being a FS and then return NOT_FOUND;
         // otherwise return GENERIC.
-        return (self->ioError != OS_SUCCESS)
-                   ? self->ioError
-               : (rc == SPIFFS_ERR_NOT_A_FS)
-                   ? OS_ERROR_NOT_FOUND
-                   : OS_ERROR_GENERIC;
+        return IoError_get((rc == SPIFFS_ERR_NOT_A_FS) ?
+                           OS_ERROR_NOT_FOUND : OS_ERROR_GENERIC);
+    }
+
+    // The index only saves lookups, so the file system is usable without it
+    if (self->extCfg.spifFs.nameIndex &&
+        SpifFsIndex_build(self) != OS_SUCCESS)
+    {
+        Debug_LOG_WARNING("Failed to index SPIFFS files, looking them up on "
+                          "the flash instead");
     }
 
     return OS_SUCCESS;
@@ -291,8 +266,21 @@ SpifFs_unmount(
 {
     spiffs *fs = &self->fs.spifFs.fs;
 
+    SpifFsIndex_clear(self);
+
     // SPIFFS_unmount does not return an error code.
     SPIFFS_unmount(fs);
 
-    return OS_SUCCESS;
+    // SPIFFS has no notion of syncing the storage, so this is the last chance
+    // to get the content of the block cache written.
+    return Storage_flush(self);
+}
+
+OS_Error_t
+SpifFs_wipe(
+    OS_FileSystem_Handle_t self)
+{
+    SpifFsIndex_clear(self);
+
+    return Storage_wipe(self, (off_t) self->cfg.format->spifFs.eraseBlockSize);
 }
@@ -14,10 +14,114 @@
 #endif
 #include "lib_debug/Debug.h"
 
+#include "lib/IoError.h"
+#include "lib/SpifFsIndex.h"
+#include "lib/Storage.h"
+
 #include <inttypes.h>
 
 // Private Functions -----------------------------------------------------------
 
+// Files which do not exist are told apart, so the name cache can note them
+static OS_Error_t
+lookupError(
+    const int rc)
+{
+    return (SPIFFS_ERR_NOT_FOUND == rc) ?
+           OS_ERROR_NOT_FOUND : IoError_get(OS_ERROR_GENERIC);
+}
+
+/*
+ * Opens the file of an index entry by the page of its index header. The page
+ * may have been taken by another object since, so the file is only used if it
+ * is still the indexed object.
+ */
+static OS_Error_t
+index_open(
+    OS_FileSystem_Handle_t     self,
+    const SpifFsIndex_Entry_t* entry,
+    const uint32_t             oflags,
+    spiffs_file*               file,
+    spiffs_stat*               stat)
+{
+    spiffs* fs = &self->fs.spifFs.fs;
+
+    if ((*file = SPIFFS_open_by_page(fs, entry->pix, oflags, 0)) < 0)
+    {
+        return OS_ERROR_NOT_FOUND;
+    }
+
+    if (SPIFFS_fstat(fs, *file, stat) < 0 ||
+        (stat->obj_id & ~SPIFFS_OBJ_ID_IX_FLAG) != entry->objId)
+    {
+        SPIFFS_close(fs, *file);
+        return OS_ERROR_NOT_FOUND;
+    }
+
+    return OS_SUCCESS;
+}
+
+// Notes where SPIFFS keeps the index header of an open file
+static void
+index_note(
+    OS_FileSystem_Handle_t self,
+    const spiffs_file      file)
+{
+    spiffs* fs = &self->fs.spifFs.fs;
+    spiffs_stat stat;
+    int rc;
+
+    if (!SpifFsIndex_isValid(self))
+    {
+        return;
+    }
+
+    // A new file which is not noted would be taken as not existing
+    if ((rc = SPIFFS_fstat(fs, file, &stat)) < 0)
+    {
+        Debug_LOG_WARNING("SPIFFS_fstat() failed with %d, dropping SPIFFS file "
+                          "index", rc);
+        SpifFsIndex_clear(self);
+        return;
+    }
+
+    SpifFsIndex_update(self, &stat);
+}
+
+static OS_Error_t
+file_seek(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile,
+    const off_t                offset)
+{
+    spiffs* fs = &self->fs.spifFs.fs;
+    spiffs_file* file = self->files[hFile];
+    ssize_t pos;
+
+    // Seeking flushes the file's cache and looks up index pages, so it is only
+    // done if the file is not already at the requested position
+    if (OS_FileSystemFile_OFFSET_CURRENT == offset ||
+        SPIFFS_tell(fs, *file) == offset)
+    {
+        return OS_SUCCESS;
+    }
+
+    if ((pos = SPIFFS_lseek(fs, *file, offset, SPIFFS_SEEK_SET)) < 0)
+    {
+        Debug_LOG_ERROR("SPIFFS_lseek() failed with %zd", pos);
+        return IoError_get(OS_ERROR_ABORTED);
+    }
+    if (pos != offset)
+    {
+        Debug_LOG_ERROR(
+            "SPIFFS_lseek() jumped to offset %zd instead of offset %" PRIiMAX,
+            pos, offset);
+        return IoError_get(OS_ERROR_ABORTED);
+    }
+
+    return OS_SUCCESS;
+}
+
 // Public Functions ------------------------------------------------------------
 
 OS_Error_t
@@ -29,7 +133,9 @@ SpifFsFile_open(
     const OS_FileSystem_OpenFlags_t flags)
 {
     spiffs* fs = &self->fs.spifFs.fs;
-    spiffs_file* file = &self->fs.spifFs.fh[hFile];
+    spiffs_file* file = self->files[hFile];
+    const SpifFsIndex_Entry_t* entry;
+    spiffs_stat stat;
     uint32_t oflags;
 
     switch (mode)
@@ -60,12 +166,38 @@ SpifFsFile_open(
         oflags |= SPIFFS_O_TRUNC;
     }
 
+    if (SpifFsIndex_isValid(self))
+    {
+        // Names which are not in the index do not exist
+        if ((entry = SpifFsIndex_find(self, name)) == NULL &&
+            !(oflags & SPIFFS_O_CREAT))
+        {
+            return OS_ERROR_NOT_FOUND;
+        }
+        // An existing file is opened by its page, also if it would have been
+        // created otherwise
+        if (entry != NULL &&
+            !(oflags & (SPIFFS_O_EXCL | SPIFFS_O_TRUNC)) &&
+            index_open(self, entry, oflags & ~SPIFFS_O_CREAT, file,
+                       &stat) == OS_SUCCESS)
+        {
+            return OS_SUCCESS;
+        }
+    }
+
     if ((*file = SPIFFS_open(fs, name, oflags, 0)) < 0)
     {
         Debug_LOG_ERROR("SPIFFS_open() failed with %d", *file);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
+        if (SPIFFS_ERR_NOT_FOUND == *file)
+        {
+            SpifFsIndex_remove(self, name);
+        }
+        return lookupError(*file);
     }
 
+    // Adds a created file or notes where the file was found
+    index_note(self, *file);
+
     return OS_SUCCESS;
 }
 
@@ -75,95 +207,117 @@ SpifFsFile_close(
     OS_FileSystemFile_Handle_t hFile)
 {
     spiffs* fs = &self->fs.spifFs.fs;
-    spiffs_file* file = &self->fs.spifFs.fh[hFile];
+    spiffs_file* file = self->files[hFile];
     int rc;
 
+    // Writes move the index header of the file, once the file is flushed the
+    // index can be told where it ended up
+    if (SpifFsIndex_isValid(self) && SPIFFS_fflush(fs, *file) == SPIFFS_OK)
+    {
+        index_note(self, *file);
+    }
+
     if ((rc = SPIFFS_close(fs, *file)) < 0)
     {
         Debug_LOG_ERROR("SPIFFS_close() failed with %d", rc);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
+        return IoError_get(OS_ERROR_GENERIC);
     }
 
-    return OS_SUCCESS;
+    // Closing a file is the point where SPIFFS has completed all its writes,
+    // so make sure they are not held back by the block cache.
+    return Storage_flush(self);
 }
 
 OS_Error_t
-SpifFsFile_read(
-    OS_FileSystem_Handle_t     self,
-    OS_FileSystemFile_Handle_t hFile,
-    const off_t                offset,
-    const size_t               len,
-    void*                      buffer)
+SpifFsFile_readv(
+    OS_FileSystem_Handle_t           self,
+    OS_FileSystemFile_Handle_t       hFile,
+    const off_t                      offset,
+    const OS_FileSystemFile_IoVec_t* iov,
+    const size_t                     iovCount)
 {
     spiffs* fs = &self->fs.spifFs.fs;
-    spiffs_file* file = &self->fs.spifFs.fh[hFile];
-    ssize_t sz, pos;
+    spiffs_file* file = self->files[hFile];
+    ssize_t sz;
+    OS_Error_t err;
 
-    if ((pos = SPIFFS_lseek(fs, *file, offset, SPIFFS_SEEK_SET)) < 0)
+    if ((err = file_seek(self, hFile, offset)) != OS_SUCCESS)
     {
-        Debug_LOG_ERROR("SPIFFS_lseek() failed with %zd", pos);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_ABORTED;
+        return err;
     }
-    if (pos != offset)
+
+    for (size_t i = 0; i < iovCount; i++)
     {
-        Debug_LOG_ERROR(
-            "SPIFFS_lseek() jumped to offset %zd instead of offset %" PRIiMAX,
-            pos, offset);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_ABORTED;
+        if ((sz = SPIFFS_read(fs, *file, iov[i].buffer, iov[i].len)) < 0)
+        {
+            Debug_LOG_ERROR("SPIFFS_read() failed with %zd", sz);
+            return IoError_get(OS_ERROR_GENERIC);
+        }
+        if (sz != iov[i].len)
+        {
+            Debug_LOG_ERROR("SPIFFS_read() read %zd bytes instead of %zu bytes",
+                            sz, iov[i].len);
+            return IoError_get(OS_ERROR_ABORTED);
+        }
     }
-    if ((sz = SPIFFS_read(fs, *file, buffer, len)) < 0)
+
+    return OS_SUCCESS;
+}
+
+OS_Error_t
+SpifFsFile_writev(
+    OS_FileSystem_Handle_t           self,
+    OS_FileSystemFile_Handle_t       hFile,
+    const off_t                      offset,
+    const OS_FileSystemFile_IoVec_t* iov,
+    const size_t                     iovCount)
+{
+    spiffs* fs = &self->fs.spifFs.fs;
+    spiffs_file* file = self->files[hFile];
+    ssize_t sz;
+    OS_Error_t err;
+
+    if ((err = file_seek(self, hFile, offset)) != OS_SUCCESS)
     {
-        Debug_LOG_ERROR("SPIFFS_read() failed with %zd", sz);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
+        return err;
     }
-    if (sz != len)
+
+    for (size_t i = 0; i < iovCount; i++)
     {
-        Debug_LOG_ERROR("SPIFFS_read() read %zd bytes instead of %zu bytes",
-                        sz, len);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_ABORTED;
+        if ((sz = SPIFFS_write(fs, *file, (void*) iov[i].buffer, iov[i].len)) < 0)
+        {
+            Debug_LOG_ERROR("SPIFFS_write() failed with %zd", sz);
+            return IoError_get(OS_ERROR_GENERIC);
+        }
+        if (sz != iov[i].len)
+        {
+            Debug_LOG_ERROR("SPIFFS_write() wrote %zd bytes instead of %zu bytes",
+                            sz, iov[i].len);
+            return IoError_get(OS_ERROR_ABORTED);
+        }
     }
 
     return OS_SUCCESS;
 }
 
 OS_Error_t
-SpifFsFile_write(
+SpifFsFile_sync(
     OS_FileSystem_Handle_t     self,
-    OS_FileSystemFile_Handle_t hFile,
-    const off_t                offset,
-    const size_t               len,
-    const void*                buffer)
+    OS_FileSystemFile_Handle_t hFile)
 {
     spiffs* fs = &self->fs.spifFs.fs;
-    spiffs_file* file = &self->fs.spifFs.fh[hFile];
-    ssize_t sz, pos;
+    spiffs_file* file = self->files[hFile];
+    int rc;
 
-    if ((pos = SPIFFS_lseek(fs, *file, offset, SPIFFS_SEEK_SET)) < 0)
+    if ((rc = SPIFFS_fflush(fs, *file)) < 0)
     {
-        Debug_LOG_ERROR("SPIFFS_lseek() failed with %zd", pos);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_ABORTED;
-    }
-    if (pos != offset)
-    {
-        Debug_LOG_ERROR(
-            "SPIFFS_lseek() jumped to offset %zd instead of offset %" PRIiMAX,
-            pos, offset);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_ABORTED;
+        Debug_LOG_ERROR("SPIFFS_fflush() failed with %d", rc);
+        return IoError_get(OS_ERROR_GENERIC);
     }
 
-    if ((sz = SPIFFS_write(fs, *file, (void*) buffer, len)) < 0)
-    {
-        Debug_LOG_ERROR("SPIFFS_write() failed with %zd", sz);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
-    }
-    if (sz != len)
-    {
-        Debug_LOG_ERROR("SPIFFS_write() wrote %zd bytes instead of %zu bytes",
-                        sz, len);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_ABORTED;
-    }
+    index_note(self, *file);
 
-    return OS_SUCCESS;
+    return Storage_flush(self);
 }
 
 OS_Error_t
@@ -172,14 +326,43 @@ SpifFsFile_delete(
     const char*            name)
 {
     spiffs* fs = &self->fs.spifFs.fs;
+    const SpifFsIndex_Entry_t* entry;
+    spiffs_stat stat;
+    spiffs_file file;
     int rc;
 
+    if (SpifFsIndex_isValid(self))
+    {
+        if ((entry = SpifFsIndex_find(self, name)) == NULL)
+        {
+            return OS_ERROR_NOT_FOUND;
+        }
+        if (index_open(self, entry, SPIFFS_O_RDWR, &file, &stat) == OS_SUCCESS)
+        {
+            rc = SPIFFS_fremove(fs, file);
+            SPIFFS_close(fs, file);
+            if (rc < 0)
+            {
+                Debug_LOG_ERROR("SPIFFS_fremove() failed with %d", rc);
+                return IoError_get(OS_ERROR_GENERIC);
+            }
+            SpifFsIndex_remove(self, name);
+            return OS_SUCCESS;
+        }
+    }
+
     if ((rc = SPIFFS_remove(fs, name)) < 0)
     {
         Debug_LOG_ERROR("SPIFFS_remove() failed with %d", rc);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
+        if (SPIFFS_ERR_NOT_FOUND == rc)
+        {
+            SpifFsIndex_remove(self, name);
+        }
+        return lookupError(rc);
     }
 
+    SpifFsIndex_remove(self, name);
+
     return OS_SUCCESS;
 }
 
@@ -190,13 +373,59 @@ SpifFsFile_getSize(
     off_t*                 sz)
 {
     spiffs* fs = &self->fs.spifFs.fs;
+    const SpifFsIndex_Entry_t* entry;
     spiffs_stat stat;
+    spiffs_file file;
     int rc;
 
+    // Opening the file by its page needs a free descriptor, without one the
+    // file is looked up by its name
+    if (SpifFsIndex_isValid(self))
+    {
+        if ((entry = SpifFsIndex_find(self, name)) == NULL)
+        {
+            return OS_ERROR_NOT_FOUND;
+        }
+        if (index_open(self, entry, SPIFFS_O_RDONLY, &file, &stat) == OS_SUCCESS)
+        {
+            SPIFFS_close(fs, file);
+            *sz = stat.size;
+            return OS_SUCCESS;
+        }
+    }
+
     if ((rc = SPIFFS_stat(fs, name, &stat)) < 0)
     {
         Debug_LOG_ERROR("SPIFFS_stat() failed with %d", rc);
-        return (self->ioError != OS_SUCCESS) ? self->ioError : OS_ERROR_GENERIC;
+        if (SPIFFS_ERR_NOT_FOUND == rc)
+        {
+            SpifFsIndex_remove(self, name);
+        }
+        return lookupError(rc);
+    }
+
+    SpifFsIndex_update(self, &stat);
+
+    *sz = stat.size;
+
+    return OS_SUCCESS;
+}
+
+OS_Error_t
+SpifFsFile_getSizeByHandle(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile,
+    off_t*                     sz)
+{
+    spiffs* fs = &self->fs.spifFs.fs;
+    spiffs_file* file = self->files[hFile];
+    spiffs_stat stat;
+    int rc;
+
+    if ((rc = SPIFFS_fstat(fs, *file, &stat)) < 0)
+    {
+        Debug_LOG_ERROR("SPIFFS_fstat() failed with %d", rc);
+        return IoError_get(OS_ERROR_GENERIC);
     }
 
     *sz = stat.size;
@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#include "OS_FileSystem.h"
+#include "OS_FileSystem_int.h"
+
+#include "lib/Hash.h"
+#include "lib/SpifFsIndex.h"
+
+#if defined(OS_FILESYSTEM_REMOVE_DEBUG_LOGGING)
+#undef Debug_Config_PRINT_TO_LOG_SERVER
+#endif
+#include "lib_debug/Debug.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Number of buckets the index starts with, it doubles as files are added
+#define INITIAL_BUCKETS 64
+
+// Private Functions -----------------------------------------------------------
+
+static SpifFsIndex_Entry_t**
+entry_find(
+    SpifFsIndex_t* idx,
+    const char*    name)
+{
+    SpifFsIndex_Entry_t** link =
+        &idx->buckets[Hash_name(name) % idx->bucketCount];
+
+    for (; *link != NULL; link = &(*link)->next)
+    {
+        if (strcmp((*link)->name, name) == 0)
+        {
+            break;
+        }
+    }
+
+    return link;
+}
+
+// If the buckets cannot be grown, the chains just get longer
+static void
+index_grow(
+    SpifFsIndex_t* idx)
+{
+    const size_t bucketCount = idx->bucketCount * 2;
+    SpifFsIndex_Entry_t** buckets;
+    SpifFsIndex_Entry_t* entry;
+
+    if ((buckets = calloc(bucketCount, sizeof(*buckets))) == NULL)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < idx->bucketCount; i++)
+    {
+        while ((entry = idx->buckets[i]) != NULL)
+        {
+            idx->buckets[i] = entry->next;
+            entry->next = buckets[Hash_name(entry->name) % bucketCount];
+            buckets[Hash_name(entry->name) % bucketCount] = entry;
+        }
+    }
+
+    free(idx->buckets);
+    idx->buckets     = buckets;
+    idx->bucketCount = bucketCount;
+}
+
+// Public Functions ------------------------------------------------------------
+
+OS_Error_t
+SpifFsIndex_build(
+    OS_FileSystem_Handle_t self)
+{
+    SpifFsIndex_t* idx = &self->fs.spifFs.index;
+    spiffs* fs = &self->fs.spifFs.fs;
+    struct spiffs_dirent dirent;
+    spiffs_stat stat;
+    spiffs_DIR dir;
+    int rc;
+
+    SpifFsIndex_clear(self);
+
+    if ((idx->buckets = calloc(INITIAL_BUCKETS, sizeof(*idx->buckets))) == NULL)
+    {
+        return OS_ERROR_INSUFFICIENT_SPACE;
+    }
+    idx->bucketCount = INITIAL_BUCKETS;
+
+    if (SPIFFS_opendir(fs, "/", &dir) == NULL)
+    {
+        Debug_LOG_ERROR("SPIFFS_opendir() failed with %d", SPIFFS_errno(fs));
+        SpifFsIndex_clear(self);
+        return OS_ERROR_GENERIC;
+    }
+
+    while (SPIFFS_readdir(&dir, &dirent) != NULL)
+    {
+        memset(&stat, 0, sizeof(stat));
+        stat.obj_id = dirent.obj_id;
+        stat.pix    = dirent.pix;
+        memcpy(stat.name, dirent.name, sizeof(stat.name));
+
+        SpifFsIndex_update(self, &stat);
+        if (!SpifFsIndex_isValid(self))
+        {
+            SPIFFS_closedir(&dir);
+            return OS_ERROR_INSUFFICIENT_SPACE;
+        }
+    }
+
+    // The end of the directory is reported as an error as well
+    rc = SPIFFS_errno(fs);
+    SPIFFS_clearerr(fs);
+    SPIFFS_closedir(&dir);
+    if (rc != SPIFFS_OK && rc != SPIFFS_VIS_END)
+    {
+        Debug_LOG_ERROR("SPIFFS_readdir() failed with %d", rc);
+        SpifFsIndex_clear(self);
+        return OS_ERROR_GENERIC;
+    }
+
+    Debug_LOG_INFO("Indexed %zu SPIFFS files", idx->count);
+
+    return OS_SUCCESS;
+}
+
+void
+SpifFsIndex_clear(
+    OS_FileSystem_Handle_t self)
+{
+    SpifFsIndex_t* idx = &self->fs.spifFs.index;
+    SpifFsIndex_Entry_t* entry;
+
+    for (size_t i = 0; i < idx->bucketCount; i++)
+    {
+        while ((entry = idx->buckets[i]) != NULL)
+        {
+            idx->buckets[i] = entry->next;
+            free(entry);
+        }
+    }
+
+    free(idx->buckets);
+    idx->buckets     = NULL;
+    idx->bucketCount = 0;
+    idx->count       = 0;
+}
+
+bool
+SpifFsIndex_isValid(
+    OS_FileSystem_Handle_t self)
+{
+    return self->fs.spifFs.index.bucketCount > 0;
+}
+
+const SpifFsIndex_Entry_t*
+SpifFsIndex_find(
+    OS_FileSystem_Handle_t self,
+    const char*            name)
+{
+    return SpifFsIndex_isValid(self) ?
+           *entry_find(&self->fs.spifFs.index, name) : NULL;
+}
+
+void
+SpifFsIndex_update(
+    OS_FileSystem_Handle_t self,
+    const spiffs_stat*     stat)
+{
+    SpifFsIndex_t* idx = &self->fs.spifFs.index;
+    const char* name = (const char*) stat->name;
+    SpifFsIndex_Entry_t** link;
+    SpifFsIndex_Entry_t* entry;
+
+    if (!SpifFsIndex_isValid(self))
+    {
+        return;
+    }
+
+    if ((entry = *entry_find(idx, name)) == NULL)
+    {
+        // A file missing from the index would be taken as not existing, so
+        // the index is dropped rather than kept incomplete
+        if ((entry = malloc(sizeof(*entry))) == NULL)
+        {
+            Debug_LOG_WARNING("Out of memory, dropping SPIFFS file index");
+            SpifFsIndex_clear(self);
+            return;
+        }
+        strncpy(entry->name, name, sizeof(entry->name) - 1);
+        entry->name[sizeof(entry->name) - 1] = '\0';
+
+        if (++idx->count > idx->bucketCount * 2)
+        {
+            index_grow(idx);
+        }
+        link = entry_find(idx, entry->name);
+        entry->next = NULL;
+        *link = entry;
+    }
+
+    entry->objId = stat->obj_id & ~SPIFFS_OBJ_ID_IX_FLAG;
+    entry->pix   = stat->pix;
+}
+
+void
+SpifFsIndex_remove(
+    OS_FileSystem_Handle_t self,
+    const char*            name)
+{
+    SpifFsIndex_t* idx = &self->fs.spifFs.index;
+    SpifFsIndex_Entry_t** link;
+    SpifFsIndex_Entry_t* entry;
+
+    if (!SpifFsIndex_isValid(self))
+    {
+        return;
+    }
+
+    link = entry_find(idx, name);
+    if ((entry = *link) != NULL)
+    {
+        *link = entry->next;
+        idx->count--;
+        free(entry);
+    }
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#include "OS_FileSystem.h"
+#include "OS_FileSystem_int.h"
+
+#include "lib/Stats.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(OS_FILESYSTEM_WITH_STATISTICS)
+
+// The counters are updated by concurrent file operations, which do not
+// necessarily hold a common lock
+#define STATS_ADD(var, val) __atomic_fetch_add(&(var), (val), __ATOMIC_RELAXED)
+
+// Private Functions -----------------------------------------------------------
+
+static unsigned int
+bucket(
+    uint64_t ticks)
+{
+    unsigned int i;
+
+    if (0 == ticks)
+    {
+        return 0;
+    }
+
+    i = 64 - __builtin_clzll(ticks);
+
+    return (i < OS_FileSystem_STATS_BUCKETS) ?
+           i : OS_FileSystem_STATS_BUCKETS - 1;
+}
+
+// Public Functions ------------------------------------------------------------
+
+uint64_t
+Stats_now(
+    OS_FileSystem_Handle_t self)
+{
+    return (NULL == self->extCfg.stats.clock) ? 0 : self->extCfg.stats.clock();
+}
+
+void
+Stats_record(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystem_CallStats_t* stats,
+    uint64_t                   start,
+    size_t                     bytes,
+    OS_Error_t                 err)
+{
+    uint64_t ticks = Stats_now(self) - start;
+
+    STATS_ADD(stats->count, 1);
+    if (err != OS_SUCCESS)
+    {
+        STATS_ADD(stats->errors, 1);
+    }
+    else
+    {
+        STATS_ADD(stats->bytes, bytes);
+    }
+    STATS_ADD(stats->time, ticks);
+    STATS_ADD(stats->histogram[bucket(ticks)], 1);
+}
+
+#endif
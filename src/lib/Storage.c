@@ -0,0 +1,543 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#include "OS_FileSystem.h"
+#include "OS_FileSystem_int.h"
+
+#include "lib/BlockCache.h"
+#include "lib/ReadAhead.h"
+#include "lib/Stats.h"
+#include "lib/Storage.h"
+#include "lib/Trace.h"
+
+#if defined(OS_FILESYSTEM_REMOVE_DEBUG_LOGGING)
+#undef Debug_Config_PRINT_TO_LOG_SERVER
+#endif
+#include "lib_debug/Debug.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+// Set while the calling thread syncs files which are flushed together
+static _Thread_local bool flushDeferred;
+
+// Private Functions -----------------------------------------------------------
+
+/*
+ * Once the storage was wiped, we keep track of the erase blocks which are known
+ * to be erased: writes clear the blocks they touch, erases set the blocks they
+ * fully cover. A following wipe can skip all blocks which are still erased.
+ */
+static void
+erased_update(
+    OS_FileSystem_Handle_t self,
+    off_t                  addr,
+    off_t                  size,
+    const bool             erased)
+{
+    const off_t blockSize = self->erased.blockSize;
+    off_t first, last;
+
+    if (NULL == self->erased.map || 0 == size)
+    {
+        return;
+    }
+
+    if (erased)
+    {
+        first = (addr + blockSize - 1) / blockSize;
+        // The last block may be shorter, if the size of the storage is not a
+        // multiple of the erase block size
+        last  = (addr + size == self->cfg.size) ?
+                (addr + size + blockSize - 1) / blockSize :
+                (addr + size) / blockSize;
+    }
+    else
+    {
+        first = addr / blockSize;
+        last  = (addr + size + blockSize - 1) / blockSize;
+    }
+
+    for (off_t b = first; b < last; b++)
+    {
+        if (erased)
+        {
+            self->erased.map[b / 8] |= (uint8_t) (1u << (b % 8));
+        }
+        else
+        {
+            self->erased.map[b / 8] &= (uint8_t) ~(1u << (b % 8));
+        }
+    }
+}
+
+static bool
+erased_isSet(
+    OS_FileSystem_Handle_t self,
+    const off_t            block)
+{
+    return self->erased.map[block / 8] & (1u << (block % 8));
+}
+
+static OS_Error_t
+storage_erase(
+    OS_FileSystem_Handle_t self,
+    off_t                  addr,
+    off_t                  size)
+{
+    OS_Error_t err;
+    off_t erased = 0;
+
+    STATS_START(self);
+    TRACE_START(self);
+
+    erased_update(self, addr, size, false);
+
+    err = self->cfg.storage.erase(addr, size, &erased);
+    STATS_STORAGE(self, ERASE, erased, err);
+    TRACE_STORAGE(self, ERASE, addr, size, err);
+    if (err != OS_SUCCESS)
+    {
+        Debug_LOG_ERROR("erase() failed with %d", err);
+        return err;
+    }
+
+    if (erased != size)
+    {
+        Debug_LOG_ERROR(
+            "erase() requested to erase %" PRIiMAX " bytes "
+            "but erased %" PRIiMAX " bytes",
+            size,
+            erased);
+        return OS_ERROR_ABORTED;
+    }
+
+    erased_update(self, addr, size, true);
+
+    return OS_SUCCESS;
+}
+
+/*
+ * Erases are held back, so runs of adjacent erases (e.g., of a SPIFFS format or
+ * garbage collection) go to the storage in a single call. The pending erase is
+ * carried out before anything else accesses its range and on every flush. If
+ * it fails, it stays pending, so the next access or flush tries it again.
+ */
+static OS_Error_t
+pending_flush(
+    OS_FileSystem_Handle_t self)
+{
+    OS_Error_t err;
+
+    if (0 == self->pendingErase.size)
+    {
+        return OS_SUCCESS;
+    }
+
+    if ((err = storage_erase(self, self->pendingErase.addr,
+                             self->pendingErase.size)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    self->pendingErase.size = 0;
+
+    return OS_SUCCESS;
+}
+
+static OS_Error_t
+pending_flushOverlap(
+    OS_FileSystem_Handle_t self,
+    const off_t            addr,
+    const off_t            size)
+{
+    if (self->pendingErase.size > 0 &&
+        addr < self->pendingErase.addr + self->pendingErase.size &&
+        addr + size > self->pendingErase.addr)
+    {
+        return pending_flush(self);
+    }
+
+    return OS_SUCCESS;
+}
+
+static OS_Error_t
+storage_read(
+    void*  ctx,
+    off_t  addr,
+    size_t size,
+    void*  buffer)
+{
+    OS_FileSystem_Handle_t self = (OS_FileSystem_Handle_t) ctx;
+    void* dataport = OS_Dataport_getBuf(self->cfg.storage.dataport);
+    size_t chunkSize = OS_Dataport_getSize(self->cfg.storage.dataport);
+    uint8_t* buf = buffer;
+    OS_Error_t err;
+    size_t read = 0, len;
+
+    if ((err = pending_flushOverlap(self, addr, size)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    // Requests which exceed the dataport are split up into chunks which fit
+    while (size > 0)
+    {
+        STATS_START(self);
+        TRACE_START(self);
+
+        len = (size > chunkSize) ? chunkSize : size;
+        err = self->cfg.storage.read(addr, len, &read);
+        STATS_STORAGE(self, READ, read, err);
+        TRACE_STORAGE(self, READ, addr, len, err);
+        if (err != OS_SUCCESS)
+        {
+            Debug_LOG_ERROR("read() failed with %d", err);
+            return err;
+        }
+
+        if (read != len)
+        {
+            Debug_LOG_ERROR("read() requested to read %zu bytes but got %zu bytes",
+                            len, read);
+            return OS_ERROR_ABORTED;
+        }
+
+        // If the backend buffer is the dataport itself, the data is already
+        // where it needs to be.
+        if (buf != dataport)
+        {
+            memcpy(buf, dataport, read);
+        }
+
+        buf  += len;
+        addr += len;
+        size -= len;
+    }
+
+    return OS_SUCCESS;
+}
+
+static OS_Error_t
+storage_write(
+    void*       ctx,
+    off_t       addr,
+    size_t      size,
+    const void* buffer)
+{
+    OS_FileSystem_Handle_t self = (OS_FileSystem_Handle_t) ctx;
+    void* dataport = OS_Dataport_getBuf(self->cfg.storage.dataport);
+    size_t chunkSize = OS_Dataport_getSize(self->cfg.storage.dataport);
+    const uint8_t* buf = buffer;
+    OS_Error_t err;
+    size_t written = 0, len;
+
+    if ((err = pending_flushOverlap(self, addr, size)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    while (size > 0)
+    {
+        STATS_START(self);
+        TRACE_START(self);
+
+        len = (size > chunkSize) ? chunkSize : size;
+        if (buf != dataport)
+        {
+            memcpy(dataport, buf, len);
+        }
+
+        erased_update(self, addr, len, false);
+
+        err = self->cfg.storage.write(addr, len, &written);
+        STATS_STORAGE(self, WRITE, written, err);
+        TRACE_STORAGE(self, WRITE, addr, len, err);
+        if (err != OS_SUCCESS)
+        {
+            Debug_LOG_ERROR("write() failed with %d", err);
+            return err;
+        }
+
+        if (written != len)
+        {
+            Debug_LOG_ERROR("write() requested to write %zu bytes but got %zu bytes",
+                            len, written);
+            return OS_ERROR_ABORTED;
+        }
+
+        buf  += len;
+        addr += len;
+        size -= len;
+    }
+
+    return OS_SUCCESS;
+}
+
+static OS_Error_t
+storage_readThrough(
+    OS_FileSystem_Handle_t self,
+    off_t                  addr,
+    size_t                 size,
+    void*                  buffer)
+{
+    return Storage_isCached(self) ?
+           BlockCache_read(&self->cache, addr, size, buffer) :
+           storage_read(self, addr, size, buffer);
+}
+
+// Public Functions ------------------------------------------------------------
+
+OS_Error_t
+Storage_init(
+    OS_FileSystem_Handle_t self)
+{
+    const OS_FileSystem_ExtConfig_t* extCfg = &self->extCfg;
+    const BlockCache_Storage_t storage =
+    {
+        .read  = storage_read,
+        .write = storage_write,
+        .ctx   = self,
+    };
+    size_t blockSize;
+
+    if (0 == extCfg->cache.blockCount)
+    {
+        return OS_SUCCESS;
+    }
+
+    // The cache reads and writes its blocks through the dataport in one go and
+    // the storage has to be made up of full blocks.
+    blockSize = extCfg->cache.blockSize;
+    if (0 == blockSize ||
+        blockSize > OS_Dataport_getSize(self->cfg.storage.dataport) ||
+        self->cfg.size % blockSize)
+    {
+        Debug_LOG_ERROR("Cache block size of %zu bytes does not fit dataport "
+                        "or storage", blockSize);
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+
+    Debug_LOG_INFO("Using block cache (block_size = %zu, block_count = %zu)",
+                   blockSize, extCfg->cache.blockCount);
+
+    return BlockCache_init(&self->cache, blockSize, extCfg->cache.blockCount,
+                           &storage);
+}
+
+OS_Error_t
+Storage_free(
+    OS_FileSystem_Handle_t self)
+{
+    OS_Error_t err;
+
+    free(self->erased.map);
+    self->erased.map = NULL;
+    self->erased.blockSize = 0;
+
+    err = pending_flush(self);
+
+    if (!Storage_isCached(self))
+    {
+        return err;
+    }
+
+    if (OS_SUCCESS == err)
+    {
+        err = BlockCache_flush(&self->cache);
+    }
+    BlockCache_free(&self->cache);
+
+    return err;
+}
+
+OS_Error_t
+Storage_read(
+    OS_FileSystem_Handle_t self,
+    off_t                  addr,
+    size_t                 size,
+    void*                  buffer)
+{
+    return (self->readAhead.size > 0) ?
+           ReadAhead_read(self, addr, size, buffer, storage_readThrough) :
+           storage_readThrough(self, addr, size, buffer);
+}
+
+OS_Error_t
+Storage_write(
+    OS_FileSystem_Handle_t self,
+    off_t                  addr,
+    size_t                 size,
+    const void*            buffer)
+{
+    ReadAhead_invalidate(self, addr, size);
+
+    return Storage_isCached(self) ?
+           BlockCache_write(&self->cache, addr, size, buffer) :
+           storage_write(self, addr, size, buffer);
+}
+
+OS_Error_t
+Storage_erase(
+    OS_FileSystem_Handle_t self,
+    off_t                  addr,
+    off_t                  size)
+{
+    OS_Error_t err;
+    off_t end;
+
+    ReadAhead_invalidate(self, addr, size);
+
+    if (Storage_isCached(self) &&
+        (err = BlockCache_discard(&self->cache, addr, size)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    // Join the pending erase if the range adjoins or lies within it
+    if (self->pendingErase.size > 0)
+    {
+        end = self->pendingErase.addr + self->pendingErase.size;
+
+        if (addr >= self->pendingErase.addr && addr <= end)
+        {
+            end = (addr + size > end) ? addr + size : end;
+            self->pendingErase.size = end - self->pendingErase.addr;
+            return OS_SUCCESS;
+        }
+        if (addr + size == self->pendingErase.addr)
+        {
+            self->pendingErase.addr = addr;
+            self->pendingErase.size += size;
+            return OS_SUCCESS;
+        }
+        if ((err = pending_flush(self)) != OS_SUCCESS)
+        {
+            return err;
+        }
+    }
+
+    self->pendingErase.addr = addr;
+    self->pendingErase.size = size;
+
+    return OS_SUCCESS;
+}
+
+OS_Error_t
+Storage_wipe(
+    OS_FileSystem_Handle_t self,
+    off_t                  blockSize)
+{
+    OS_Error_t err;
+    off_t blockCount, b, run, addr, size;
+
+    if (0 == blockSize)
+    {
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+
+    blockCount = (self->cfg.size + blockSize - 1) / blockSize;
+
+    // The wipe covers a pending erase, so it can be dropped; blocks of it which
+    // are not known to be erased are erased below anyway
+    self->pendingErase.size = 0;
+
+    // Whatever is cached is gone along with the storage
+    ReadAhead_invalidate(self, 0, self->cfg.size);
+    if (Storage_isCached(self) &&
+        (err = BlockCache_discard(&self->cache, 0,
+                                  self->cfg.size)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    // Nothing is known about the storage before its first wipe
+    if (self->erased.blockSize != blockSize)
+    {
+        free(self->erased.map);
+        self->erased.blockSize = blockSize;
+        if ((self->erased.map = calloc((blockCount + 7) / 8, 1)) == NULL)
+        {
+            self->erased.blockSize = 0;
+            return OS_ERROR_INSUFFICIENT_SPACE;
+        }
+    }
+
+    // Erase each run of blocks which are not known to be erased in one go
+    for (b = 0; b < blockCount; b += run)
+    {
+        if (erased_isSet(self, b))
+        {
+            run = 1;
+            continue;
+        }
+
+        for (run = 1; b + run < blockCount && !erased_isSet(self, b + run); run++)
+        {
+            ;
+        }
+
+        addr = b * blockSize;
+        size = run * blockSize;
+        size = (addr + size > self->cfg.size) ? self->cfg.size - addr : size;
+        if ((err = storage_erase(self, addr, size)) != OS_SUCCESS)
+        {
+            return err;
+        }
+    }
+
+    return OS_SUCCESS;
+}
+
+OS_Error_t
+Storage_flush(
+    OS_FileSystem_Handle_t self)
+{
+    OS_Error_t err;
+
+    if (flushDeferred)
+    {
+        return OS_SUCCESS;
+    }
+
+    if ((err = pending_flush(self)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    return Storage_isCached(self) ?
+           BlockCache_flush(&self->cache) :
+           OS_SUCCESS;
+}
+
+void
+Storage_deferFlush(
+    bool defer)
+{
+    flushDeferred = defer;
+}
+
+bool
+Storage_isCached(
+    OS_FileSystem_Handle_t self)
+{
+    return self->cache.blockCount > 0;
+}
+
+bool
+Storage_sharesDataport(
+    OS_FileSystem_Handle_t self)
+{
+    // The block cache reads and writes its blocks through the dataport, also
+    // when it flushes on a sync; the read-ahead fills its buffer through the
+    // dataport before it reads the rest of a request
+    return Storage_isCached(self) || self->readAhead.size > 0;
+}
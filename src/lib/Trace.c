@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#include "OS_FileSystem.h"
+#include "OS_FileSystem_int.h"
+
+#include "lib/Trace.h"
+
+#if defined(OS_FILESYSTEM_REMOVE_DEBUG_LOGGING)
+#undef Debug_Config_PRINT_TO_LOG_SERVER
+#endif
+#include "lib_debug/Debug.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(OS_FILESYSTEM_WITH_TRACE)
+
+// Operation the calling thread is performing
+static _Thread_local uint8_t currentOp = UINT8_MAX;
+
+// Public Functions ------------------------------------------------------------
+
+OS_Error_t
+Trace_init(
+    OS_FileSystem_Handle_t self)
+{
+    const OS_FileSystem_ExtConfig_t* extCfg = &self->extCfg;
+
+    if (NULL == extCfg->trace.buffer)
+    {
+        return OS_SUCCESS;
+    }
+    if (0 == extCfg->trace.entries || extCfg->trace.entries > UINT32_MAX)
+    {
+        Debug_LOG_ERROR("Trace buffer of %zu entries is not supported",
+                        extCfg->trace.entries);
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+
+    self->trace.buffer  = extCfg->trace.buffer;
+    self->trace.entries = extCfg->trace.entries;
+    self->trace.next    = 0;
+
+    for (size_t i = 0; i < self->trace.entries; i++)
+    {
+        self->trace.buffer[i].seq = 0;
+    }
+
+    return OS_SUCCESS;
+}
+
+void
+Trace_setOp(
+    OS_FileSystem_StatsOp_t op)
+{
+    currentOp = op;
+}
+
+uint64_t
+Trace_now(
+    OS_FileSystem_Handle_t self)
+{
+    return (NULL == self->trace.buffer || NULL == self->extCfg.stats.clock) ?
+           0 : self->extCfg.stats.clock();
+}
+
+void
+Trace_record(
+    OS_FileSystem_Handle_t       self,
+    OS_FileSystem_StatsStorage_t call,
+    off_t                        addr,
+    size_t                       size,
+    uint64_t                     start,
+    OS_Error_t                   err)
+{
+    Trace_t* t = &self->trace;
+    OS_FileSystem_TraceEntry_t* e;
+    uint64_t ticks;
+    uint32_t seq;
+
+    if (NULL == t->buffer)
+    {
+        return;
+    }
+
+    ticks = Trace_now(self) - start;
+
+    // Each writer claims its own entry; the sequence number is written last,
+    // so a reader skips entries which are being written (zero) or stale
+    seq = __atomic_fetch_add(&t->next, 1, __ATOMIC_RELAXED);
+    e = &t->buffer[seq % t->entries];
+    __atomic_store_n(&e->seq, 0, __ATOMIC_RELAXED);
+
+    e->addr     = (uint64_t) addr;
+    e->size     = (size > UINT32_MAX) ? UINT32_MAX : (uint32_t) size;
+    e->duration = (ticks > UINT32_MAX) ? UINT32_MAX : (uint32_t) ticks;
+    e->call     = (uint8_t) call;
+    e->op       = currentOp;
+    e->error    = (err != OS_SUCCESS);
+    e->reserved = 0;
+
+    __atomic_store_n(&e->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+#endif
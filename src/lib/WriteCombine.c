@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#include "OS_FileSystem.h"
+#include "OS_FileSystem_int.h"
+
+#include "lib/WriteCombine.h"
+
+#if defined(OS_FILESYSTEM_REMOVE_DEBUG_LOGGING)
+#undef Debug_Config_PRINT_TO_LOG_SERVER
+#endif
+#include "lib_debug/Debug.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Private Functions -----------------------------------------------------------
+
+static uint64_t
+now(
+    OS_FileSystem_Handle_t self)
+{
+    return (NULL == self->extCfg.stats.clock) ? 0 : self->extCfg.stats.clock();
+}
+
+static bool
+isExpired(
+    OS_FileSystem_Handle_t     self,
+    const WriteCombine_File_t* file)
+{
+    const uint64_t maxAge = self->extCfg.writeCombine.maxAge;
+
+    return maxAge > 0 && NULL != self->extCfg.stats.clock &&
+           now(self) - file->since >= maxAge;
+}
+
+// Check if a write continues the buffered data and fits into the buffer
+static bool
+isContinued(
+    OS_FileSystem_Handle_t     self,
+    const WriteCombine_File_t* file,
+    const off_t                offset,
+    const size_t               len)
+{
+    if (0 == len || file->len + len > self->writeCombine.size)
+    {
+        return false;
+    }
+    if (0 == file->len || OS_FileSystemFile_OFFSET_CURRENT == offset)
+    {
+        return true;
+    }
+
+    return file->offset != OS_FileSystemFile_OFFSET_CURRENT &&
+           offset == file->offset + (off_t) file->len;
+}
+
+// Public Functions ------------------------------------------------------------
+
+OS_Error_t
+WriteCombine_init(
+    OS_FileSystem_Handle_t self)
+{
+    WriteCombine_t* wc = &self->writeCombine;
+
+    if (0 == self->extCfg.writeCombine.size)
+    {
+        return OS_SUCCESS;
+    }
+
+    if ((wc->files = calloc(self->handles.count,
+                            sizeof(WriteCombine_File_t))) == NULL)
+    {
+        return OS_ERROR_INSUFFICIENT_SPACE;
+    }
+
+    wc->size = self->extCfg.writeCombine.size;
+
+    Debug_LOG_INFO("Combining writes of up to %zu bytes", wc->size);
+
+    return OS_SUCCESS;
+}
+
+void
+WriteCombine_free(
+    OS_FileSystem_Handle_t self)
+{
+    WriteCombine_t* wc = &self->writeCombine;
+
+    if (0 == wc->size)
+    {
+        return;
+    }
+
+    // Data of files which have not been closed is dropped
+    for (size_t i = 0; i < self->handles.count; i++)
+    {
+        free(wc->files[i].data);
+    }
+    free(wc->files);
+
+    memset(wc, 0, sizeof(WriteCombine_t));
+}
+
+OS_Error_t
+WriteCombine_write(
+    OS_FileSystem_Handle_t           self,
+    OS_FileSystemFile_Handle_t       hFile,
+    const off_t                      offset,
+    const OS_FileSystemFile_IoVec_t* iov,
+    const size_t                     iovCount)
+{
+    WriteCombine_File_t* file;
+    OS_Error_t err;
+    size_t len = 0;
+
+    if (0 == self->writeCombine.size ||
+        self->writeCombine.files[hFile].readOnly)
+    {
+        return self->fileOps->writev(self, hFile, offset, iov, iovCount);
+    }
+
+    for (size_t i = 0; i < iovCount; i++)
+    {
+        len += iov[i].len;
+    }
+
+    file = &self->writeCombine.files[hFile];
+    if (!isContinued(self, file, offset, len) &&
+        (err = WriteCombine_flush(self, hFile)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    // Writes which would fill the buffer on their own go through, as well as
+    // empty ones, which only move the current position of the file
+    if (0 == len || len >= self->writeCombine.size)
+    {
+        return self->fileOps->writev(self, hFile, offset, iov, iovCount);
+    }
+
+    if (NULL == file->data &&
+        (file->data = malloc(self->writeCombine.size)) == NULL)
+    {
+        return self->fileOps->writev(self, hFile, offset, iov, iovCount);
+    }
+
+    if (0 == file->len)
+    {
+        file->offset = offset;
+        file->since  = now(self);
+    }
+    for (size_t i = 0; i < iovCount; i++)
+    {
+        memcpy(file->data + file->len, iov[i].buffer, iov[i].len);
+        file->len += iov[i].len;
+    }
+
+    return isExpired(self, file) ? WriteCombine_flush(self, hFile) : OS_SUCCESS;
+}
+
+OS_Error_t
+WriteCombine_flush(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile)
+{
+    WriteCombine_File_t* file;
+    OS_FileSystemFile_IoVec_t iov;
+    OS_Error_t err;
+
+    if (0 == self->writeCombine.size)
+    {
+        return OS_SUCCESS;
+    }
+
+    file = &self->writeCombine.files[hFile];
+    if (0 == file->len)
+    {
+        return OS_SUCCESS;
+    }
+
+    iov.buffer = file->data;
+    iov.len    = file->len;
+    err = self->fileOps->writev(self, hFile, file->offset, &iov, 1);
+
+    // The data is dropped also if the write failed, so the error is reported
+    // once and does not come back with each later call for the file
+    if (err != OS_SUCCESS)
+    {
+        Debug_LOG_ERROR("Writing %zu buffered bytes to file handle %d failed "
+                        "with %d, dropping them", file->len, hFile, err);
+    }
+
+    file->len = 0;
+
+    return err;
+}
+
+OS_Error_t
+WriteCombine_flushAll(
+    OS_FileSystem_Handle_t self)
+{
+    OS_Error_t err, ret = OS_SUCCESS;
+
+    if (0 == self->writeCombine.size)
+    {
+        return OS_SUCCESS;
+    }
+
+    for (size_t i = 0; i < self->handles.count; i++)
+    {
+        if (HandleBitmap_inUse(&self->handles, i) &&
+            (err = WriteCombine_flush(self, i)) != OS_SUCCESS)
+        {
+            ret = err;
+        }
+    }
+
+    return ret;
+}
+
+void
+WriteCombine_open(
+    OS_FileSystem_Handle_t         self,
+    OS_FileSystemFile_Handle_t     hFile,
+    const OS_FileSystem_OpenMode_t mode)
+{
+    if (0 == self->writeCombine.size)
+    {
+        return;
+    }
+
+    self->writeCombine.files[hFile].readOnly =
+        (OS_FileSystem_OpenMode_RDONLY == mode);
+}
+
+void
+WriteCombine_close(
+    OS_FileSystem_Handle_t     self,
+    OS_FileSystemFile_Handle_t hFile)
+{
+    WriteCombine_File_t* file;
+
+    if (0 == self->writeCombine.size)
+    {
+        return;
+    }
+
+    file = &self->writeCombine.files[hFile];
+    free(file->data);
+    memset(file, 0, sizeof(WriteCombine_File_t));
+}
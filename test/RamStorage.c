@@ -0,0 +1,347 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#include "RamStorage.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static struct
+{
+    uint8_t* mem;
+    off_t size;
+    void* dataport;
+    size_t dataportSize;
+    RamStorage_Latency_t latency;
+    RamStorage_Stats_t stats;
+    uint64_t time;
+    bool flash;
+    uint32_t* eraseCounts;
+    size_t blockCount;
+    uint64_t powerLossCalls;    ///< Writes and erases until the power is lost
+    bool powerLost;
+} storage;
+
+// Private Functions -----------------------------------------------------------
+
+static bool
+isInRange(
+    const off_t offset,
+    const off_t size)
+{
+    return offset >= 0 && size >= 0 && offset <= storage.size &&
+           size <= storage.size - offset;
+}
+
+// Count down to the power loss; returns false if the power is lost at this call
+static bool
+hasPower(void)
+{
+    if (storage.powerLossCalls > 0 && 0 == --storage.powerLossCalls)
+    {
+        storage.powerLost = true;
+        return false;
+    }
+
+    return !storage.powerLost;
+}
+
+// Like a NOR flash, a write can only clear bits
+static bool
+isProgrammable(
+    const off_t    offset,
+    const uint8_t* data,
+    const size_t   size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        if ((storage.mem[offset + i] & data[i]) != data[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static uint64_t
+writeTime(
+    const off_t  offset,
+    const size_t size)
+{
+    const size_t pageSize = storage.latency.pageSize;
+
+    if (0 == pageSize)
+    {
+        return storage.latency.writeByteTime * size;
+    }
+
+    return storage.latency.programTime *
+           ((offset + size + pageSize - 1) / pageSize - offset / pageSize);
+}
+
+// Public Functions ------------------------------------------------------------
+
+OS_Error_t
+RamStorage_init(
+    const off_t                 size,
+    const size_t                dataportSize,
+    const RamStorage_Latency_t* latency)
+{
+    RamStorage_free();
+
+    if (NULL != latency)
+    {
+        storage.latency = *latency;
+    }
+    if (storage.latency.eraseBlockSize > 0)
+    {
+        storage.blockCount = (size + storage.latency.eraseBlockSize - 1) /
+                             storage.latency.eraseBlockSize;
+        storage.eraseCounts = calloc(storage.blockCount, sizeof(uint32_t));
+    }
+
+    storage.mem      = malloc(size);
+    storage.dataport = malloc(dataportSize);
+    if (NULL == storage.mem || NULL == storage.dataport ||
+        (storage.blockCount > 0 && NULL == storage.eraseCounts))
+    {
+        RamStorage_free();
+        return OS_ERROR_INSUFFICIENT_SPACE;
+    }
+
+    memset(storage.mem, 0xff, size);
+    storage.size         = size;
+    storage.dataportSize = dataportSize;
+
+    return OS_SUCCESS;
+}
+
+void
+RamStorage_free(void)
+{
+    free(storage.mem);
+    free(storage.dataport);
+    free(storage.eraseCounts);
+
+    memset(&storage, 0, sizeof(storage));
+}
+
+void
+RamStorage_assign(
+    OS_FileSystem_Config_t* cfg)
+{
+    const OS_Dataport_t dataport =
+        OS_DATAPORT_ASSIGN_SIZE(storage.dataport, storage.dataportSize);
+
+    cfg->storage.read     = RamStorage_read;
+    cfg->storage.write    = RamStorage_write;
+    cfg->storage.erase    = RamStorage_erase;
+    cfg->storage.getSize  = RamStorage_getSize;
+    cfg->storage.getState = RamStorage_getState;
+    cfg->storage.dataport = dataport;
+}
+
+void
+RamStorage_getStats(
+    RamStorage_Stats_t* stats)
+{
+    *stats = storage.stats;
+}
+
+void
+RamStorage_resetStats(void)
+{
+    memset(&storage.stats, 0, sizeof(storage.stats));
+    storage.time = 0;
+    if (NULL != storage.eraseCounts)
+    {
+        memset(storage.eraseCounts, 0, storage.blockCount * sizeof(uint32_t));
+    }
+}
+
+void
+RamStorage_setFlash(
+    const bool flash)
+{
+    storage.flash = flash;
+}
+
+const uint32_t*
+RamStorage_getEraseCounts(
+    size_t* count)
+{
+    *count = storage.blockCount;
+
+    return storage.eraseCounts;
+}
+
+void
+RamStorage_setPowerLoss(
+    const uint64_t calls)
+{
+    storage.powerLossCalls = calls;
+    storage.powerLost      = false;
+}
+
+uint64_t
+RamStorage_getTime(void)
+{
+    return storage.time;
+}
+
+uint8_t*
+RamStorage_getMem(void)
+{
+    return storage.mem;
+}
+
+OS_Error_t
+RamStorage_read(
+    off_t   offset,
+    size_t  size,
+    size_t* read)
+{
+    *read = 0;
+
+    if (storage.powerLost)
+    {
+        return OS_ERROR_ABORTED;
+    }
+    if (size > storage.dataportSize)
+    {
+        return OS_ERROR_BUFFER_TOO_SMALL;
+    }
+    if (!isInRange(offset, size))
+    {
+        return OS_ERROR_OUT_OF_BOUNDS;
+    }
+
+    memcpy(storage.dataport, storage.mem + offset, size);
+
+    storage.stats.reads++;
+    storage.stats.bytesRead += size;
+    storage.time += storage.latency.callTime +
+                    storage.latency.readByteTime * size;
+
+    *read = size;
+
+    return OS_SUCCESS;
+}
+
+OS_Error_t
+RamStorage_write(
+    off_t   offset,
+    size_t  size,
+    size_t* written)
+{
+    *written = 0;
+
+    if (storage.powerLost)
+    {
+        return OS_ERROR_ABORTED;
+    }
+    if (size > storage.dataportSize)
+    {
+        return OS_ERROR_BUFFER_TOO_SMALL;
+    }
+    if (!isInRange(offset, size))
+    {
+        return OS_ERROR_OUT_OF_BOUNDS;
+    }
+
+    if (storage.flash && !isProgrammable(offset, storage.dataport, size))
+    {
+        storage.stats.badWrites++;
+        return OS_ERROR_INVALID_STATE;
+    }
+
+    storage.stats.writes++;
+    storage.time += storage.latency.callTime;
+
+    if (!hasPower())
+    {
+        memcpy(storage.mem + offset, storage.dataport, size / 2);
+        return OS_ERROR_ABORTED;
+    }
+
+    memcpy(storage.mem + offset, storage.dataport, size);
+
+    storage.stats.bytesWritten += size;
+    storage.time += writeTime(offset, size);
+
+    *written = size;
+
+    return OS_SUCCESS;
+}
+
+OS_Error_t
+RamStorage_erase(
+    off_t  offset,
+    off_t  size,
+    off_t* erased)
+{
+    const size_t blockSize = storage.latency.eraseBlockSize;
+
+    *erased = 0;
+
+    if (storage.powerLost)
+    {
+        return OS_ERROR_ABORTED;
+    }
+    if (!isInRange(offset, size))
+    {
+        return OS_ERROR_OUT_OF_BOUNDS;
+    }
+    if (blockSize > 0 && (offset % blockSize || size % blockSize))
+    {
+        return OS_ERROR_INVALID_PARAMETER;
+    }
+
+    storage.stats.erases++;
+    storage.time += storage.latency.callTime;
+
+    if (!hasPower())
+    {
+        memset(storage.mem + offset, 0xff, size / 2);
+        return OS_ERROR_ABORTED;
+    }
+
+    memset(storage.mem + offset, 0xff, size);
+
+    for (off_t b = 0; blockSize > 0 && b < size / (off_t) blockSize; b++)
+    {
+        storage.eraseCounts[offset / blockSize + b]++;
+    }
+
+    storage.stats.bytesErased += size;
+    storage.time += storage.latency.eraseTime *
+                    ((blockSize > 0) ? size / blockSize : 1);
+
+    *erased = size;
+
+    return OS_SUCCESS;
+}
+
+OS_Error_t
+RamStorage_getSize(
+    off_t* size)
+{
+    *size = storage.size;
+
+    return OS_SUCCESS;
+}
+
+OS_Error_t
+RamStorage_getState(
+    uint32_t* flags)
+{
+    *flags = 0;
+
+    return OS_SUCCESS;
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+#pragma once
+
+#include "OS_FileSystem.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Storage in RAM behind the storage callbacks of OS_FileSystem_Config_t, for
+ * tests and benchmarks on the host. Since the callbacks have no context, there
+ * is a single storage.
+ *
+ * Calls do not take any time; instead, each call adds its cost according to
+ * the latency model to a simulated clock, so results do not depend on the
+ * host. Erased bytes read as 0xff.
+ *
+ * The storage can also behave like a NOR flash, see RamStorage_setFlash(): it
+ * then counts the erases of each erase block and can lose power at a chosen
+ * point, see RamStorage_setPowerLoss().
+ */
+
+typedef struct
+{
+    uint64_t callTime;          ///< Cost of each call, e.g., of the RPC
+    uint64_t readByteTime;      ///< Cost of each byte read
+    uint64_t writeByteTime;     ///< Cost of each byte written
+    uint64_t eraseTime;         ///< Cost of each erase block erased
+    /// Erases have to cover whole blocks of this size, zero for any range
+    size_t eraseBlockSize;
+    /// Cost of each page a write touches, instead of the cost per byte
+    uint64_t programTime;
+    size_t pageSize;            ///< Size of a page, zero for none
+} RamStorage_Latency_t;
+
+typedef struct
+{
+    uint64_t reads;             ///< Number of read calls
+    uint64_t writes;            ///< Number of write calls
+    uint64_t erases;            ///< Number of erase calls
+    uint64_t bytesRead;
+    uint64_t bytesWritten;
+    uint64_t bytesErased;
+    /// Number of writes refused since they would have to set bits, in the
+    /// flash mode
+    uint64_t badWrites;
+} RamStorage_Stats_t;
+
+/*
+ * Set up a storage of the given size, erased, with a dataport of the given
+ * size; a NULL latency model makes all calls free.
+ */
+OS_Error_t
+RamStorage_init(
+    const off_t                 size,
+    const size_t                dataportSize,
+    const RamStorage_Latency_t* latency);
+
+void
+RamStorage_free(void);
+
+// Set the storage callbacks and the dataport of a file system configuration
+void
+RamStorage_assign(
+    OS_FileSystem_Config_t* cfg);
+
+void
+RamStorage_getStats(
+    RamStorage_Stats_t* stats);
+
+void
+RamStorage_resetStats(void);
+
+// Simulated time taken by the calls so far, in the unit of the latency model
+uint64_t
+RamStorage_getTime(void);
+
+/*
+ * Switch the flash mode on or off. Like on a NOR flash, a write can then only
+ * clear bits; a write which would have to set a bit of a byte which was not
+ * erased fails with OS_ERROR_INVALID_STATE and changes nothing.
+ */
+void
+RamStorage_setFlash(
+    const bool flash);
+
+/*
+ * Number of erases of each erase block since the storage was set up or the
+ * statistics were reset; NULL if the latency model has no erase block size.
+ */
+const uint32_t*
+RamStorage_getEraseCounts(
+    size_t* count);
+
+/*
+ * Lose power after the given number of further writes and erases. The write
+ * or erase which follows them only changes the first half of its range and
+ * fails with OS_ERROR_ABORTED, so do all calls after it until this is called
+ * again. Zero restores the power and does not lose it again.
+ */
+void
+RamStorage_setPowerLoss(
+    const uint64_t calls);
+
+// Direct access to the content of the storage
+uint8_t*
+RamStorage_getMem(void);
+
+// The storage callbacks
+OS_Error_t
+RamStorage_read(
+    off_t   offset,
+    size_t  size,
+    size_t* read);
+
+OS_Error_t
+RamStorage_write(
+    off_t   offset,
+    size_t  size,
+    size_t* written);
+
+OS_Error_t
+RamStorage_erase(
+    off_t  offset,
+    off_t  size,
+    off_t* erased);
+
+OS_Error_t
+RamStorage_getSize(
+    off_t* size);
+
+OS_Error_t
+RamStorage_getState(
+    uint32_t* flags);
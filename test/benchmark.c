@@ -0,0 +1,787 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+/*
+ * Benchmark of the file system types on a RAM storage. Each workload runs on a
+ * freshly formatted file system; for each it reports
+ *
+ * - the throughput, as the data read and written by the workload divided by
+ *   the time it took on the host plus the simulated time of the storage, and
+ *   the file system operations per second in the same time,
+ * - the number of storage calls, i.e., RPCs to the storage server,
+ * - the write amplification, as the bytes written to the storage divided by
+ *   the bytes written by the workload.
+ *
+ * With -f, the storage behaves like a NOR flash instead and a wear workload,
+ * which rewrites a file and appends to a log, runs on each file system type.
+ * For each it reports
+ *
+ * - how often the erase blocks were erased (total, min, median, max),
+ * - the time to mount the file system after a clean unmount,
+ * - the time to mount it again after the power was lost at points spread
+ *   over the workload (mean, max) and how often that failed.
+ *
+ * FatFs is left out there, it needs a storage which can rewrite in place.
+ *
+ * Usage: benchmark [-n] [-f [-c blockCycles]] [littlefs|fatfs|spiffs ...]
+ *
+ * With -n, the storage calls take no time. With -c, LittleFS is formatted with
+ * the given number of erase cycles per block before it moves a block. Without
+ * file system types, all of them are run.
+ */
+
+#include "OS_FileSystem.h"
+#include "OS_FileSystem_ext.h"
+
+#include "RamStorage.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define STORAGE_SIZE    (2 * 1024 * 1024)
+#define DATAPORT_SIZE   4096
+
+#define FILE_SIZE       (512 * 1024)
+#define CHUNK_SIZE      4096
+#define RANDOM_SIZE     512
+#define RANDOM_COUNT    512
+#define SMALL_SIZE      1024
+#define SMALL_COUNT     64
+#define APPEND_SIZE     256
+#define APPEND_COUNT    128
+#define WEAR_SIZE       4096
+#define WEAR_COUNT      256
+#define POWER_LOSSES    16
+
+// Storage behind an RPC, reads at 100 MB/s, writes at 20 MB/s, erasing a
+// block of 4 KiB takes 1 ms; times are in nanoseconds
+static const RamStorage_Latency_t latency =
+{
+    .callTime       = 20000,
+    .readByteTime   = 10,
+    .writeByteTime  = 50,
+    .eraseTime      = 1000000,
+    .eraseBlockSize = 4096,
+};
+
+// A NOR flash behind an RPC, programming a page of 256 bytes takes 0.7 ms,
+// erasing a block of 4 KiB takes 45 ms
+static const RamStorage_Latency_t flashLatency =
+{
+    .callTime       = 20000,
+    .readByteTime   = 10,
+    .programTime    = 700000,
+    .pageSize       = 256,
+    .eraseTime      = 45000000,
+    .eraseBlockSize = 4096,
+};
+
+typedef struct
+{
+    const char* name;
+    OS_FileSystem_Type_t type;
+    bool onFlash;               ///< Works without rewriting in place
+} Backend_t;
+
+static const Backend_t backends[] =
+{
+    { "littlefs", OS_FileSystem_Type_LITTLEFS, true },
+    { "fatfs",    OS_FileSystem_Type_FATFS,    false },
+    { "spiffs",   OS_FileSystem_Type_SPIFFS,   true },
+};
+
+// Data read and written and operations done by a workload
+typedef struct
+{
+    uint64_t read;
+    uint64_t written;
+    uint64_t ops;
+} Payload_t;
+
+typedef OS_Error_t (*Workload_t)(
+    OS_FileSystem_Handle_t hFs,
+    Payload_t*             payload);
+
+static uint8_t buffer[CHUNK_SIZE];
+
+// Private Functions -----------------------------------------------------------
+
+static uint64_t
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Deterministic offsets for the random accesses
+static uint32_t
+nextRandom(
+    uint32_t* state)
+{
+    *state = *state * 1103515245u + 12345u;
+
+    return *state >> 8;
+}
+
+static OS_Error_t
+writeFile(
+    OS_FileSystem_Handle_t hFs,
+    const char*            name,
+    const size_t           size,
+    const size_t           chunkSize,
+    Payload_t*             payload)
+{
+    OS_FileSystemFile_Handle_t hFile;
+    OS_Error_t err;
+
+    if ((err = OS_FileSystemFile_open(hFs, &hFile, name,
+                                      OS_FileSystem_OpenMode_RDWR,
+                                      OS_FileSystem_OpenFlags_CREATE)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    for (size_t off = 0; off < size && OS_SUCCESS == err; off += chunkSize)
+    {
+        err = OS_FileSystemFile_write(hFs, hFile, off, chunkSize, buffer);
+        payload->ops++;
+    }
+
+    if (OS_SUCCESS == err)
+    {
+        err = OS_FileSystemFile_close(hFs, hFile);
+    }
+    else
+    {
+        OS_FileSystemFile_close(hFs, hFile);
+    }
+
+    payload->written += size;
+    payload->ops += 2;
+
+    return err;
+}
+
+static OS_Error_t
+readFile(
+    OS_FileSystem_Handle_t hFs,
+    const char*            name,
+    const size_t           size,
+    const size_t           chunkSize,
+    Payload_t*             payload)
+{
+    OS_FileSystemFile_Handle_t hFile;
+    OS_Error_t err;
+
+    if ((err = OS_FileSystemFile_open(hFs, &hFile, name,
+                                      OS_FileSystem_OpenMode_RDONLY,
+                                      OS_FileSystem_OpenFlags_NONE)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    for (size_t off = 0; off < size && OS_SUCCESS == err; off += chunkSize)
+    {
+        err = OS_FileSystemFile_read(hFs, hFile, off, chunkSize, buffer);
+        payload->ops++;
+    }
+
+    OS_FileSystemFile_close(hFs, hFile);
+
+    payload->read += size;
+    payload->ops += 2;
+
+    return err;
+}
+
+static void
+fileName(
+    char*        name,
+    const size_t len,
+    const size_t i)
+{
+    snprintf(name, len, "file%03zu", i);
+}
+
+// Workloads -------------------------------------------------------------------
+
+static OS_Error_t
+workload_sequential(
+    OS_FileSystem_Handle_t hFs,
+    Payload_t*             payload)
+{
+    OS_Error_t err;
+
+    if ((err = writeFile(hFs, "seq", FILE_SIZE, CHUNK_SIZE,
+                         payload)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    return readFile(hFs, "seq", FILE_SIZE, CHUNK_SIZE, payload);
+}
+
+static OS_Error_t
+workload_random(
+    OS_FileSystem_Handle_t hFs,
+    Payload_t*             payload)
+{
+    const size_t blocks = FILE_SIZE / RANDOM_SIZE;
+    OS_FileSystemFile_Handle_t hFile;
+    Payload_t setup = { 0 };
+    uint32_t state = 1;
+    off_t off;
+    OS_Error_t err = OS_SUCCESS;
+
+    if ((err = writeFile(hFs, "rnd", FILE_SIZE, CHUNK_SIZE,
+                         &setup)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    if ((err = OS_FileSystemFile_open(hFs, &hFile, "rnd",
+                                      OS_FileSystem_OpenMode_RDWR,
+                                      OS_FileSystem_OpenFlags_NONE)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    // Every fourth access writes
+    for (size_t i = 0; i < RANDOM_COUNT && OS_SUCCESS == err; i++)
+    {
+        off = (off_t) (nextRandom(&state) % blocks) * RANDOM_SIZE;
+        if (i % 4 == 3)
+        {
+            err = OS_FileSystemFile_write(hFs, hFile, off, RANDOM_SIZE, buffer);
+            payload->written += RANDOM_SIZE;
+        }
+        else
+        {
+            err = OS_FileSystemFile_read(hFs, hFile, off, RANDOM_SIZE, buffer);
+            payload->read += RANDOM_SIZE;
+        }
+        payload->ops++;
+    }
+
+    OS_FileSystemFile_close(hFs, hFile);
+
+    return err;
+}
+
+static OS_Error_t
+workload_smallFiles(
+    OS_FileSystem_Handle_t hFs,
+    Payload_t*             payload)
+{
+    char name[16];
+    OS_Error_t err;
+
+    for (size_t i = 0; i < SMALL_COUNT; i++)
+    {
+        fileName(name, sizeof(name), i);
+        if ((err = writeFile(hFs, name, SMALL_SIZE, SMALL_SIZE,
+                             payload)) != OS_SUCCESS)
+        {
+            return err;
+        }
+    }
+
+    for (size_t i = 0; i < SMALL_COUNT; i++)
+    {
+        fileName(name, sizeof(name), i);
+        if ((err = readFile(hFs, name, SMALL_SIZE, SMALL_SIZE,
+                            payload)) != OS_SUCCESS)
+        {
+            return err;
+        }
+    }
+
+    return OS_SUCCESS;
+}
+
+static OS_Error_t
+workload_metadata(
+    OS_FileSystem_Handle_t hFs,
+    Payload_t*             payload)
+{
+    Payload_t setup = { 0 };
+    char name[16];
+    off_t sz;
+    OS_Error_t err;
+
+    for (size_t i = 0; i < SMALL_COUNT; i++)
+    {
+        fileName(name, sizeof(name), i);
+        if ((err = writeFile(hFs, name, 0, SMALL_SIZE, &setup)) != OS_SUCCESS)
+        {
+            return err;
+        }
+    }
+
+    // Look up existing and missing names, then delete the files
+    for (size_t i = 0; i < 2 * SMALL_COUNT; i++)
+    {
+        fileName(name, sizeof(name), i);
+        err = OS_FileSystemFile_getSize(hFs, name, &sz);
+        if ((i < SMALL_COUNT) ?
+            OS_SUCCESS != err : OS_ERROR_NOT_FOUND != err)
+        {
+            return (OS_SUCCESS == err) ? OS_ERROR_GENERIC : err;
+        }
+        payload->ops++;
+    }
+
+    for (size_t i = 0; i < SMALL_COUNT; i++)
+    {
+        fileName(name, sizeof(name), i);
+        if ((err = OS_FileSystemFile_delete(hFs, name)) != OS_SUCCESS)
+        {
+            return err;
+        }
+        payload->ops++;
+    }
+
+    return OS_SUCCESS;
+}
+
+static OS_Error_t
+workload_append(
+    OS_FileSystem_Handle_t hFs,
+    Payload_t*             payload)
+{
+    OS_FileSystemFile_Handle_t hFile;
+    off_t sz = 0;
+    OS_Error_t err;
+
+    // Like a log, which is opened for each entry
+    for (size_t i = 0; i < APPEND_COUNT; i++)
+    {
+        if ((err = OS_FileSystemFile_open(hFs, &hFile, "log",
+                                          OS_FileSystem_OpenMode_WRONLY,
+                                          (0 == i) ?
+                                          OS_FileSystem_OpenFlags_CREATE :
+                                          OS_FileSystem_OpenFlags_NONE)) != OS_SUCCESS)
+        {
+            return err;
+        }
+        err = OS_FileSystemFile_write(hFs, hFile, sz, APPEND_SIZE, buffer);
+        OS_FileSystemFile_close(hFs, hFile);
+        if (err != OS_SUCCESS)
+        {
+            return err;
+        }
+        sz += APPEND_SIZE;
+        payload->written += APPEND_SIZE;
+        payload->ops += 3;
+    }
+
+    return OS_SUCCESS;
+}
+
+static OS_Error_t
+workload_wear(
+    OS_FileSystem_Handle_t hFs,
+    Payload_t*             payload)
+{
+    OS_FileSystemFile_Handle_t hFile;
+    off_t sz = 0;
+    OS_Error_t err;
+
+    // Like a configuration which is saved along with an entry in a log
+    for (size_t i = 0; i < WEAR_COUNT; i++)
+    {
+        if ((err = writeFile(hFs, "cfg", WEAR_SIZE, WEAR_SIZE,
+                             payload)) != OS_SUCCESS)
+        {
+            return err;
+        }
+
+        if ((err = OS_FileSystemFile_open(hFs, &hFile, "log",
+                                          OS_FileSystem_OpenMode_WRONLY,
+                                          OS_FileSystem_OpenFlags_CREATE)) != OS_SUCCESS)
+        {
+            return err;
+        }
+        err = OS_FileSystemFile_write(hFs, hFile, sz, APPEND_SIZE, buffer);
+        OS_FileSystemFile_close(hFs, hFile);
+        if (err != OS_SUCCESS)
+        {
+            return err;
+        }
+        sz += APPEND_SIZE;
+        payload->written += APPEND_SIZE;
+        payload->ops += 3;
+    }
+
+    return OS_SUCCESS;
+}
+
+static const struct
+{
+    const char* name;
+    Workload_t run;
+} workloads[] =
+{
+    { "sequential", workload_sequential },
+    { "random",     workload_random },
+    { "small-file", workload_smallFiles },
+    { "metadata",   workload_metadata },
+    { "append",     workload_append },
+};
+
+// Run -------------------------------------------------------------------------
+
+static int
+run(
+    const Backend_t* backend,
+    const bool       withLatency)
+{
+    OS_FileSystem_Config_t cfg =
+    {
+        .type = backend->type,
+        .size = OS_FileSystem_USE_STORAGE_MAX,
+    };
+    OS_FileSystem_Handle_t hFs;
+    RamStorage_Stats_t stats;
+    Payload_t payload;
+    uint64_t start, time, calls;
+    OS_Error_t err;
+
+    for (size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++)
+    {
+        if ((err = RamStorage_init(STORAGE_SIZE, DATAPORT_SIZE,
+                                   withLatency ? &latency : NULL)) != OS_SUCCESS)
+        {
+            return 1;
+        }
+        RamStorage_assign(&cfg);
+
+        if ((err = OS_FileSystem_init(&hFs, &cfg)) != OS_SUCCESS ||
+            (err = OS_FileSystem_format(hFs)) != OS_SUCCESS ||
+            (err = OS_FileSystem_mount(hFs)) != OS_SUCCESS)
+        {
+            printf("%-8s %-10s setup failed with %d\n",
+                   backend->name, workloads[i].name, err);
+            return 1;
+        }
+
+        RamStorage_resetStats();
+        memset(&payload, 0, sizeof(payload));
+
+        start = now();
+        err = workloads[i].run(hFs, &payload);
+        if (OS_SUCCESS == err)
+        {
+            err = OS_FileSystem_unmount(hFs);
+        }
+        time = now() - start + RamStorage_getTime();
+
+        OS_FileSystem_free(hFs);
+        RamStorage_getStats(&stats);
+
+        if (err != OS_SUCCESS)
+        {
+            printf("%-8s %-10s failed with %d\n",
+                   backend->name, workloads[i].name, err);
+            return 1;
+        }
+
+        calls = stats.reads + stats.writes + stats.erases;
+        printf("%-8s %-10s %8.2f %8.0f %8" PRIu64 " %8" PRIu64 " %8" PRIu64
+               " %8" PRIu64,
+               backend->name, workloads[i].name,
+               (double) (payload.read + payload.written) * 1000 / time,
+               (double) payload.ops * 1000000000 / time,
+               calls, stats.reads, stats.writes, stats.erases);
+        if (payload.written > 0)
+        {
+            printf(" %8.2f\n", (double) stats.bytesWritten / payload.written);
+        }
+        else
+        {
+            printf(" %8s\n", "-");
+        }
+    }
+
+    return 0;
+}
+
+// Flash -----------------------------------------------------------------------
+
+static int
+compareCounts(
+    const void* a,
+    const void* b)
+{
+    const uint32_t x = *(const uint32_t*) a, y = *(const uint32_t*) b;
+
+    return (x > y) - (x < y);
+}
+
+// Set up a flash with a formatted file system on it
+static OS_Error_t
+flashSetUp(
+    OS_FileSystem_Config_t* cfg)
+{
+    OS_FileSystem_Handle_t hFs;
+    OS_Error_t err;
+
+    if ((err = RamStorage_init(STORAGE_SIZE, DATAPORT_SIZE,
+                               &flashLatency)) != OS_SUCCESS)
+    {
+        return err;
+    }
+    RamStorage_setFlash(true);
+    RamStorage_assign(cfg);
+
+    if ((err = OS_FileSystem_init(&hFs, cfg)) != OS_SUCCESS)
+    {
+        return err;
+    }
+    err = OS_FileSystem_format(hFs);
+    OS_FileSystem_free(hFs);
+
+    return err;
+}
+
+// Mount the file system on the flash; the time includes that of the storage
+static OS_Error_t
+flashMount(
+    const OS_FileSystem_Config_t* cfg,
+    OS_FileSystem_Handle_t*       hFs,
+    uint64_t*                     time)
+{
+    uint64_t start;
+    OS_Error_t err;
+
+    if ((err = OS_FileSystem_init(hFs, cfg)) != OS_SUCCESS)
+    {
+        return err;
+    }
+
+    RamStorage_resetStats();
+    start = now();
+    err = OS_FileSystem_mount(*hFs);
+    *time = now() - start + RamStorage_getTime();
+
+    if (err != OS_SUCCESS)
+    {
+        OS_FileSystem_free(*hFs);
+    }
+
+    return err;
+}
+
+static int
+runFlash(
+    const Backend_t*              backend,
+    const OS_FileSystem_Format_t* format)
+{
+    OS_FileSystem_Config_t cfg =
+    {
+        .type   = backend->type,
+        .size   = OS_FileSystem_USE_STORAGE_MAX,
+        .format = format,
+    };
+    OS_FileSystem_Handle_t hFs;
+    RamStorage_Stats_t stats;
+    Payload_t payload = { 0 };
+    const uint32_t* counts;
+    uint32_t* sorted;
+    uint64_t time, mountTime, recoveryTime = 0, recoveryMax = 0, calls, total = 0;
+    size_t count, lost = 0;
+    OS_Error_t err;
+
+    if ((err = flashSetUp(&cfg)) != OS_SUCCESS ||
+        (err = flashMount(&cfg, &hFs, &time)) != OS_SUCCESS)
+    {
+        printf("%-8s setup failed with %d\n", backend->name, err);
+        return 1;
+    }
+
+    RamStorage_resetStats();
+    err = workload_wear(hFs, &payload);
+    if (OS_SUCCESS == err)
+    {
+        err = OS_FileSystem_unmount(hFs);
+    }
+    OS_FileSystem_free(hFs);
+    if (err != OS_SUCCESS)
+    {
+        printf("%-8s wear failed with %d\n", backend->name, err);
+        return 1;
+    }
+
+    RamStorage_getStats(&stats);
+    calls = stats.writes + stats.erases;
+
+    counts = RamStorage_getEraseCounts(&count);
+    if ((sorted = malloc(count * sizeof(uint32_t))) == NULL)
+    {
+        return 1;
+    }
+    memcpy(sorted, counts, count * sizeof(uint32_t));
+    qsort(sorted, count, sizeof(uint32_t), compareCounts);
+    for (size_t b = 0; b < count; b++)
+    {
+        total += sorted[b];
+    }
+
+    if ((err = flashMount(&cfg, &hFs, &mountTime)) != OS_SUCCESS)
+    {
+        printf("%-8s mount failed with %d\n", backend->name, err);
+        free(sorted);
+        return 1;
+    }
+    OS_FileSystem_unmount(hFs);
+    OS_FileSystem_free(hFs);
+
+    // Lose the power at points spread over the workload, then mount again
+    for (size_t i = 1; i <= POWER_LOSSES; i++)
+    {
+        if ((err = flashSetUp(&cfg)) != OS_SUCCESS ||
+            (err = flashMount(&cfg, &hFs, &time)) != OS_SUCCESS)
+        {
+            printf("%-8s setup failed with %d\n", backend->name, err);
+            free(sorted);
+            return 1;
+        }
+
+        RamStorage_setPowerLoss(calls * i / (POWER_LOSSES + 1));
+        workload_wear(hFs, &payload);
+        OS_FileSystem_free(hFs);
+        RamStorage_setPowerLoss(0);
+
+        if (flashMount(&cfg, &hFs, &time) != OS_SUCCESS)
+        {
+            lost++;
+            continue;
+        }
+        OS_FileSystem_unmount(hFs);
+        OS_FileSystem_free(hFs);
+
+        recoveryTime += time;
+        recoveryMax = (time > recoveryMax) ? time : recoveryMax;
+    }
+
+    printf("%-8s %8" PRIu64 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32
+           " %8" PRIu64 " %8.2f %8.2f %8.2f %8zu\n",
+           backend->name, total, sorted[0], sorted[count / 2],
+           sorted[count - 1], stats.badWrites, (double) mountTime / 1000000,
+           (POWER_LOSSES > lost) ?
+           (double) recoveryTime / (POWER_LOSSES - lost) / 1000000 : 0.0,
+           (double) recoveryMax / 1000000, lost);
+
+    free(sorted);
+
+    return 0;
+}
+
+// Main ------------------------------------------------------------------------
+
+int
+main(
+    int   argc,
+    char* argv[])
+{
+    OS_FileSystem_Format_t littleFs =
+    {
+        .littleFs = {
+            .readSize = 16,
+            .writeSize = 16,
+            .blockSize = 4096,
+            .blockCycles = 0,
+        }
+    };
+    bool withLatency = true, onFlash = false;
+    bool selected[sizeof(backends) / sizeof(backends[0])] = { false };
+    bool any = false;
+    int failed = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool found = false;
+
+        if (strcmp(argv[i], "-n") == 0)
+        {
+            withLatency = false;
+            continue;
+        }
+        if (strcmp(argv[i], "-f") == 0)
+        {
+            onFlash = true;
+            continue;
+        }
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+        {
+            littleFs.littleFs.blockCycles = atoi(argv[++i]);
+            continue;
+        }
+        for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++)
+        {
+            if (strcmp(argv[i], backends[b].name) == 0)
+            {
+                selected[b] = found = any = true;
+            }
+        }
+        if (!found)
+        {
+            fprintf(stderr, "Usage: %s [-n] [-f [-c blockCycles]] "
+                    "[littlefs|fatfs|spiffs ...]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    memset(buffer, 0xa5, sizeof(buffer));
+
+    if (onFlash)
+    {
+        printf("%-8s %8s %8s %8s %8s %8s %8s %8s %8s %8s\n",
+               "type", "erases", "min", "median", "max", "bad-wr",
+               "mount ms", "recov ms", "max ms", "lost");
+
+        for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++)
+        {
+            if (backends[b].onFlash && (!any || selected[b]))
+            {
+                failed += runFlash(&backends[b],
+                                   (OS_FileSystem_Type_LITTLEFS == backends[b].type &&
+                                    littleFs.littleFs.blockCycles > 0) ?
+                                   &littleFs : NULL);
+            }
+        }
+
+        RamStorage_free();
+
+        return failed ? 1 : 0;
+    }
+
+    printf("%-8s %-10s %8s %8s %8s %8s %8s %8s %8s\n",
+           "type", "workload", "MB/s", "ops/s", "calls", "reads", "writes",
+           "erases", "wr-amp");
+
+    for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++)
+    {
+        if (!any || selected[b])
+        {
+            failed += run(&backends[b], withLatency);
+        }
+    }
+
+    RamStorage_free();
+
+    return failed ? 1 : 0;
+}
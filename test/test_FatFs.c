@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+/*
+ * Tests of the changes to FatFs, run on the host against a disk in RAM.
+ */
+
+#include "ff.h"
+#include "diskio.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SECTOR_SIZE     512
+#define SECTOR_COUNT    2048
+
+#define TEST_TRUE(cond)                                                 \
+    do {                                                                \
+        if (!(cond))                                                    \
+        {                                                               \
+            printf("%s:%d: %s failed\n", __func__, __LINE__, #cond);    \
+            return 1;                                                   \
+        }                                                               \
+    } while (0)
+
+#define TEST_RC(call)   TEST_TRUE((call) == FR_OK)
+
+static uint8_t disk[SECTOR_COUNT * SECTOR_SIZE];
+static DIO dio;
+static FCTX fctx;
+static FATFS fs;
+
+// Private Functions -----------------------------------------------------------
+
+static DSTATUS
+disk_initialize_ram(
+    void* ctx,
+    BYTE  pdrv)
+{
+    return 0;
+}
+
+static DSTATUS
+disk_status_ram(
+    void* ctx,
+    BYTE  pdrv)
+{
+    return 0;
+}
+
+static DRESULT
+disk_read_ram(
+    void* ctx,
+    BYTE  pdrv,
+    BYTE* buff,
+    LBA_t sector,
+    UINT  count)
+{
+    if (sector + count > SECTOR_COUNT)
+    {
+        return RES_PARERR;
+    }
+
+    memcpy(buff, disk + sector * SECTOR_SIZE, count * SECTOR_SIZE);
+
+    return RES_OK;
+}
+
+static DRESULT
+disk_write_ram(
+    void*       ctx,
+    BYTE        pdrv,
+    const BYTE* buff,
+    LBA_t       sector,
+    UINT        count)
+{
+    if (sector + count > SECTOR_COUNT)
+    {
+        return RES_PARERR;
+    }
+
+    memcpy(disk + sector * SECTOR_SIZE, buff, count * SECTOR_SIZE);
+
+    return RES_OK;
+}
+
+static DRESULT
+disk_ioctl_ram(
+    void* ctx,
+    BYTE  pdrv,
+    BYTE  cmd,
+    void* buff)
+{
+    switch (cmd)
+    {
+    case CTRL_SYNC:
+        return RES_OK;
+    case GET_SECTOR_COUNT:
+        *(LBA_t*) buff = SECTOR_COUNT;
+        return RES_OK;
+    case GET_SECTOR_SIZE:
+        *(WORD*) buff = SECTOR_SIZE;
+        return RES_OK;
+    case GET_BLOCK_SIZE:
+        *(DWORD*) buff = 1;
+        return RES_OK;
+    default:
+        return RES_PARERR;
+    }
+}
+
+// One sector per cluster, so a few bytes already span several clusters
+static int
+setUp(void)
+{
+    static BYTE work[FF_MAX_SS];
+    const MKFS_PARM parms =
+    {
+        .fmt     = FM_FAT | FM_SFD,
+        .n_fat   = 1,
+        .au_size = SECTOR_SIZE,
+    };
+
+    memset(disk, 0xff, sizeof(disk));
+
+    dio.disk_initialize = disk_initialize_ram;
+    dio.disk_status     = disk_status_ram;
+    dio.disk_read       = disk_read_ram;
+    dio.disk_write      = disk_write_ram;
+    dio.disk_ioctl      = disk_ioctl_ram;
+    fctx.dio = &dio;
+
+    TEST_RC(f_mkfs(&fctx, "", &parms, work, sizeof(work)));
+    TEST_RC(f_mount(&fctx, &fs, "", 1));
+
+    return 0;
+}
+
+static void
+fill(
+    uint8_t*     buf,
+    const size_t len,
+    const size_t off)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        buf[i] = (uint8_t) ((off + i) * 7);
+    }
+}
+
+static int
+check(
+    FIL*         fp,
+    const size_t off,
+    const size_t len)
+{
+    static uint8_t buf[4 * SECTOR_SIZE], ref[4 * SECTOR_SIZE];
+    UINT n;
+
+    TEST_TRUE(len <= sizeof(buf));
+    TEST_RC(f_lseek(&fctx, fp, off));
+    TEST_RC(f_read(&fctx, fp, buf, len, &n));
+    TEST_TRUE(n == len);
+    fill(ref, len, off);
+    TEST_TRUE(!memcmp(buf, ref, len));
+
+    return 0;
+}
+
+// Test Functions --------------------------------------------------------------
+
+/*
+ * A file which is created has no cluster yet when its link map table is set
+ * up; the first cluster written has to end up in the table.
+ */
+static int
+test_FatFs_fastSeek_writeNewFile(void)
+{
+    DWORD tbl[16];
+    uint8_t buf[100];
+    FIL fp;
+    UINT n;
+
+    TEST_RC(f_open(&fctx, &fp, "new", FA_CREATE_ALWAYS | FA_READ | FA_WRITE));
+
+    tbl[0] = sizeof(tbl) / sizeof(DWORD);
+    fp.cltbl = tbl;
+    TEST_RC(f_lseek(&fctx, &fp, CREATE_LINKMAP));
+
+    fill(buf, sizeof(buf), 0);
+    TEST_RC(f_write(&fctx, &fp, buf, sizeof(buf), &n));
+    TEST_TRUE(n == sizeof(buf));
+    TEST_TRUE(fp.cltbl == tbl);
+    TEST_TRUE(tbl[1] == 1 && tbl[2] == fp.obj.sclust);
+
+    if (check(&fp, 50, 50) || check(&fp, 0, 100))
+    {
+        return 1;
+    }
+
+    TEST_RC(f_close(&fctx, &fp));
+
+    return 0;
+}
+
+/*
+ * The table of a file without a cluster needs room for the first one.
+ */
+static int
+test_FatFs_fastSeek_emptyFileTableSize(void)
+{
+    DWORD tbl[3];
+    FIL fp;
+
+    TEST_RC(f_open(&fctx, &fp, "empty", FA_CREATE_ALWAYS | FA_WRITE));
+
+    tbl[0] = sizeof(tbl) / sizeof(DWORD);
+    fp.cltbl = tbl;
+    TEST_TRUE(f_lseek(&fctx, &fp, CREATE_LINKMAP) == FR_NOT_ENOUGH_CORE);
+    TEST_TRUE(tbl[0] == 4);
+
+    fp.cltbl = NULL;
+    TEST_RC(f_close(&fctx, &fp));
+
+    return 0;
+}
+
+/*
+ * Seeks and reads beyond what the table maps follow the chain on the FAT
+ * instead of failing, and the file stays usable.
+ */
+static int
+test_FatFs_fastSeek_beyondTable(void)
+{
+    static uint8_t buf[4 * SECTOR_SIZE];
+    DWORD tbl[16];
+    FIL fp;
+    UINT n;
+
+    TEST_RC(f_open(&fctx, &fp, "long", FA_CREATE_ALWAYS | FA_READ | FA_WRITE));
+    fill(buf, sizeof(buf), 0);
+    TEST_RC(f_write(&fctx, &fp, buf, sizeof(buf), &n));
+    TEST_TRUE(n == sizeof(buf));
+
+    tbl[0] = sizeof(tbl) / sizeof(DWORD);
+    fp.cltbl = tbl;
+    TEST_RC(f_lseek(&fctx, &fp, CREATE_LINKMAP));
+    TEST_TRUE(tbl[1] == 4);
+
+    // Pretend the table maps just the first cluster
+    tbl[1] = 1;
+    TEST_RC(f_lseek(&fctx, &fp, 0));
+    TEST_RC(f_read(&fctx, &fp, buf, sizeof(buf), &n));
+    TEST_TRUE(n == sizeof(buf));
+    TEST_TRUE(NULL == fp.cltbl);
+
+    fp.cltbl = tbl;
+    if (check(&fp, 3 * SECTOR_SIZE + 10, 100))
+    {
+        return 1;
+    }
+    TEST_TRUE(NULL == fp.cltbl);
+
+    if (check(&fp, 0, sizeof(buf)))
+    {
+        return 1;
+    }
+
+    TEST_RC(f_close(&fctx, &fp));
+
+    return 0;
+}
+
+// Main ------------------------------------------------------------------------
+
+int
+main(void)
+{
+    int failed = 0;
+
+    if (setUp())
+    {
+        return 1;
+    }
+
+    failed += test_FatFs_fastSeek_writeNewFile();
+    failed += test_FatFs_fastSeek_emptyFileTableSize();
+    failed += test_FatFs_fastSeek_beyondTable();
+
+    printf("%d test(s) failed\n", failed);
+
+    return failed ? 1 : 0;
+}
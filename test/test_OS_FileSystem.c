@@ -0,0 +1,370 @@
+/*
+ * Copyright (C) 2024, HENSOLDT Cyber GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * For commercial licensing, contact: info.cyber@hensoldt.net
+ */
+
+/*
+ * Tests of the whole module, run on the host against a RAM storage. They are
+ * built with OS_FILESYSTEM_USE_ZERO_COPY, so the layers which use the dataport
+ * on their own behalf are checked against the LittleFS read cache placed in
+ * it.
+ */
+
+#include "OS_FileSystem.h"
+#include "OS_FileSystem_ext.h"
+#include "OS_FileSystem_int.h"
+
+#include "RamStorage.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define STORAGE_SIZE    (1024 * 1024)
+#define DATAPORT_SIZE   4096
+#define FILE_SIZE       (64 * 1024)
+#define CHUNK_SIZE      1000
+
+#define TEST_TRUE(cond)                                                 \
+    do {                                                                \
+        if (!(cond))                                                    \
+        {                                                               \
+            printf("%s:%d: %s failed\n", __func__, __LINE__, #cond);    \
+            return 1;                                                   \
+        }                                                               \
+    } while (0)
+
+#define TEST_RC(call)   TEST_TRUE((call) == OS_SUCCESS)
+
+static uint8_t buf[FILE_SIZE], ref[FILE_SIZE];
+
+// Private Functions -----------------------------------------------------------
+
+static void
+fill(
+    uint8_t*     data,
+    const size_t len,
+    const size_t off)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        data[i] = (uint8_t) ((off + i) * 7 + (off + i) / 251);
+    }
+}
+
+static int
+setUp(
+    OS_FileSystem_Handle_t*          hFs,
+    const OS_FileSystem_ExtConfig_t* extCfg)
+{
+    OS_FileSystem_Config_t cfg =
+    {
+        .type = OS_FileSystem_Type_LITTLEFS,
+        .size = OS_FileSystem_USE_STORAGE_MAX,
+    };
+
+    TEST_RC(RamStorage_init(STORAGE_SIZE, DATAPORT_SIZE, NULL));
+    RamStorage_assign(&cfg);
+
+    TEST_RC(OS_FileSystem_initExt(hFs, &cfg, extCfg));
+    TEST_RC(OS_FileSystem_format(*hFs));
+    TEST_RC(OS_FileSystem_mount(*hFs));
+
+    return 0;
+}
+
+static int
+tearDown(
+    OS_FileSystem_Handle_t hFs)
+{
+    TEST_RC(OS_FileSystem_unmount(hFs));
+    TEST_RC(OS_FileSystem_free(hFs));
+    RamStorage_free();
+
+    return 0;
+}
+
+/*
+ * Write a file, mount again so nothing is left in the caches, then read it
+ * back sequentially in chunks which do not line up with the caches and at
+ * a few offsets out of order.
+ */
+static int
+writeAndReadBack(
+    OS_FileSystem_Handle_t hFs)
+{
+    static const off_t offsets[] = { 40000, 3, 61000, 8191, 20480 };
+    OS_FileSystemFile_Handle_t hFile;
+    size_t len;
+
+    fill(ref, sizeof(ref), 0);
+
+    TEST_RC(OS_FileSystemFile_open(hFs, &hFile, "file",
+                                   OS_FileSystem_OpenMode_RDWR,
+                                   OS_FileSystem_OpenFlags_CREATE));
+    TEST_RC(OS_FileSystemFile_write(hFs, hFile, 0, sizeof(ref), ref));
+    TEST_RC(OS_FileSystemFile_close(hFs, hFile));
+
+    TEST_RC(OS_FileSystem_unmount(hFs));
+    TEST_RC(OS_FileSystem_mount(hFs));
+
+    TEST_RC(OS_FileSystemFile_open(hFs, &hFile, "file",
+                                   OS_FileSystem_OpenMode_RDONLY,
+                                   OS_FileSystem_OpenFlags_NONE));
+
+    memset(buf, 0, sizeof(buf));
+    for (size_t off = 0; off < sizeof(buf); off += len)
+    {
+        len = (sizeof(buf) - off > CHUNK_SIZE) ? CHUNK_SIZE : sizeof(buf) - off;
+        TEST_RC(OS_FileSystemFile_read(hFs, hFile, off, len, buf + off));
+    }
+    TEST_TRUE(!memcmp(buf, ref, sizeof(ref)));
+
+    for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++)
+    {
+        memset(buf, 0, CHUNK_SIZE);
+        TEST_RC(OS_FileSystemFile_read(hFs, hFile, offsets[i], CHUNK_SIZE, buf));
+        TEST_TRUE(!memcmp(buf, ref + offsets[i], CHUNK_SIZE));
+    }
+
+    TEST_RC(OS_FileSystemFile_close(hFs, hFile));
+
+    return 0;
+}
+
+// Test Functions --------------------------------------------------------------
+
+/*
+ * Without anything else using the dataport, the read cache is placed in it.
+ */
+static int
+test_OS_FileSystem_zeroCopy(void)
+{
+    OS_FileSystem_Handle_t hFs;
+
+    if (setUp(&hFs, NULL))
+    {
+        return 1;
+    }
+
+    TEST_TRUE(hFs->fs.littleFs.cfg.read_buffer ==
+              OS_Dataport_getBuf(hFs->cfg.storage.dataport));
+
+    if (writeAndReadBack(hFs))
+    {
+        return 1;
+    }
+
+    return tearDown(hFs);
+}
+
+/*
+ * The read-ahead fills its buffer through the dataport and then reads the rest
+ * of a request, which would overwrite data the read cache holds there.
+ */
+static int
+test_OS_FileSystem_zeroCopy_readAhead(void)
+{
+    const OS_FileSystem_ExtConfig_t extCfg =
+    {
+        .readAhead.size = DATAPORT_SIZE,
+    };
+    OS_FileSystem_Handle_t hFs;
+
+    if (setUp(&hFs, &extCfg))
+    {
+        return 1;
+    }
+
+    TEST_TRUE(hFs->fs.littleFs.cfg.read_buffer !=
+              OS_Dataport_getBuf(hFs->cfg.storage.dataport));
+
+    if (writeAndReadBack(hFs))
+    {
+        return 1;
+    }
+
+    return tearDown(hFs);
+}
+
+/*
+ * The block cache moves its blocks through the dataport.
+ */
+static int
+test_OS_FileSystem_zeroCopy_blockCache(void)
+{
+    const OS_FileSystem_ExtConfig_t extCfg =
+    {
+        .cache.blockSize  = DATAPORT_SIZE,
+        .cache.blockCount = 4,
+    };
+    OS_FileSystem_Handle_t hFs;
+
+    if (setUp(&hFs, &extCfg))
+    {
+        return 1;
+    }
+
+    TEST_TRUE(hFs->fs.littleFs.cfg.read_buffer !=
+              OS_Dataport_getBuf(hFs->cfg.storage.dataport));
+
+    if (writeAndReadBack(hFs))
+    {
+        return 1;
+    }
+
+    return tearDown(hFs);
+}
+
+/*
+ * A wipe is refused while the file system is mounted or a file is open.
+ */
+static int
+test_OS_FileSystem_wipe_inUse(void)
+{
+    OS_FileSystem_Handle_t hFs;
+    OS_FileSystemFile_Handle_t hFile;
+    off_t sz;
+
+    if (setUp(&hFs, NULL))
+    {
+        return 1;
+    }
+
+    TEST_RC(OS_FileSystemFile_open(hFs, &hFile, "file",
+                                   OS_FileSystem_OpenMode_RDWR,
+                                   OS_FileSystem_OpenFlags_CREATE));
+    TEST_TRUE(OS_FileSystem_wipe(hFs) == OS_ERROR_INVALID_STATE);
+    TEST_RC(OS_FileSystemFile_close(hFs, hFile));
+    TEST_TRUE(OS_FileSystem_wipe(hFs) == OS_ERROR_INVALID_STATE);
+
+    TEST_RC(OS_FileSystem_unmount(hFs));
+    TEST_RC(OS_FileSystem_wipe(hFs));
+
+    TEST_RC(OS_FileSystem_format(hFs));
+    TEST_RC(OS_FileSystem_mount(hFs));
+    TEST_TRUE(OS_FileSystemFile_getSize(hFs, "file", &sz) == OS_ERROR_NOT_FOUND);
+
+    return tearDown(hFs);
+}
+
+/*
+ * With write-combine, a write to a file opened read-only fails right away
+ * instead of being buffered, and a buffered write which fails when it is
+ * written to the storage is reported once; the file can still be closed and
+ * the file system unmounted.
+ */
+static int
+test_OS_FileSystem_writeCombine_error(void)
+{
+    const OS_FileSystem_ExtConfig_t extCfg =
+    {
+        .writeCombine.size = 2 * DATAPORT_SIZE,
+    };
+    OS_FileSystem_Handle_t hFs;
+    OS_FileSystemFile_Handle_t hFile;
+    off_t sz;
+
+    if (setUp(&hFs, &extCfg))
+    {
+        return 1;
+    }
+
+    fill(ref, sizeof(ref), 0);
+
+    TEST_RC(OS_FileSystemFile_open(hFs, &hFile, "file",
+                                   OS_FileSystem_OpenMode_RDWR,
+                                   OS_FileSystem_OpenFlags_CREATE));
+    TEST_RC(OS_FileSystemFile_close(hFs, hFile));
+
+    TEST_RC(OS_FileSystemFile_open(hFs, &hFile, "file",
+                                   OS_FileSystem_OpenMode_RDONLY,
+                                   OS_FileSystem_OpenFlags_NONE));
+    TEST_TRUE(OS_FileSystemFile_write(hFs, hFile, 0, 100, ref) != OS_SUCCESS);
+    TEST_RC(OS_FileSystemFile_getSize(hFs, "file", &sz));
+    TEST_TRUE(0 == sz);
+    TEST_RC(OS_FileSystemFile_close(hFs, hFile));
+
+    // The buffered data is more than LittleFS caches, so writing it has to go
+    // to the storage, which fails until the power is back
+    TEST_RC(OS_FileSystemFile_open(hFs, &hFile, "file",
+                                   OS_FileSystem_OpenMode_RDWR,
+                                   OS_FileSystem_OpenFlags_NONE));
+    TEST_RC(OS_FileSystemFile_write(hFs, hFile, 0, DATAPORT_SIZE + 100, ref));
+    RamStorage_setPowerLoss(1);
+    TEST_TRUE(OS_FileSystemFile_close(hFs, hFile) != OS_SUCCESS);
+    RamStorage_setPowerLoss(0);
+
+    TEST_TRUE(OS_FileSystemFile_close(hFs, hFile) == OS_ERROR_INVALID_HANDLE);
+
+    return tearDown(hFs);
+}
+
+/*
+ * The result of a request without a callback which is never polled is
+ * discarded when its file is closed, so the request does not keep its place
+ * in the queue.
+ */
+static int
+test_OS_FileSystem_async_closeReleases(void)
+{
+    const OS_FileSystem_ExtConfig_t extCfg =
+    {
+        .async.queueSize = 1,
+    };
+    OS_FileSystem_Handle_t hFs;
+    OS_FileSystemFile_Handle_t hFile;
+    OS_FileSystem_AsyncToken_t token;
+    OS_Error_t result;
+
+    if (setUp(&hFs, &extCfg))
+    {
+        return 1;
+    }
+
+    fill(ref, sizeof(ref), 0);
+
+    TEST_RC(OS_FileSystemFile_open(hFs, &hFile, "file",
+                                   OS_FileSystem_OpenMode_RDWR,
+                                   OS_FileSystem_OpenFlags_CREATE));
+    TEST_RC(OS_FileSystemFile_writeAsync(hFs, hFile, 0, CHUNK_SIZE, ref, NULL,
+                                         NULL, &token));
+    TEST_RC(OS_FileSystemFile_close(hFs, hFile));
+    TEST_TRUE(OS_FileSystem_pollAsync(hFs, token, &result) ==
+              OS_ERROR_NOT_FOUND);
+
+    TEST_RC(OS_FileSystemFile_open(hFs, &hFile, "file",
+                                   OS_FileSystem_OpenMode_RDONLY,
+                                   OS_FileSystem_OpenFlags_NONE));
+    TEST_RC(OS_FileSystemFile_readAsync(hFs, hFile, 0, CHUNK_SIZE, buf, NULL,
+                                        NULL, &token));
+    TEST_RC(OS_FileSystem_processAsync(hFs, 1, NULL));
+    TEST_RC(OS_FileSystem_pollAsync(hFs, token, &result));
+    TEST_RC(result);
+    TEST_TRUE(!memcmp(buf, ref, CHUNK_SIZE));
+    TEST_RC(OS_FileSystemFile_close(hFs, hFile));
+
+    return tearDown(hFs);
+}
+
+// Main ------------------------------------------------------------------------
+
+int
+main(void)
+{
+    int failed = 0;
+
+    failed += test_OS_FileSystem_zeroCopy();
+    failed += test_OS_FileSystem_zeroCopy_readAhead();
+    failed += test_OS_FileSystem_zeroCopy_blockCache();
+    failed += test_OS_FileSystem_wipe_inUse();
+    failed += test_OS_FileSystem_writeCombine_error();
+    failed += test_OS_FileSystem_async_closeReleases();
+
+    printf("%d test(s) failed\n", failed);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+#
+# OS FileSystem storage trace decoder
+#
+# Copyright (C) 2024, HENSOLDT Cyber GmbH
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+# For commercial licensing, contact: info.cyber@hensoldt.net
+#
+
+"""
+Decode a dump of the storage trace buffer (OS_FileSystem_TraceEntry_t[], see
+OS_FileSystem_ext.h) and print statistics of the access pattern: calls per
+operation, size distribution, sequentiality and an access heatmap of the
+storage and, for flash, the wear of its erase blocks.
+"""
+
+import argparse
+import collections
+import struct
+import sys
+
+ENTRY = struct.Struct("<QIIIBBBB")
+
+CALLS = ["read", "write", "erase"]
+OPS = ["open", "close", "read", "write", "sync", "delete", "getSize",
+       "format", "mount", "unmount", "wipe"]
+
+
+def op_name(op):
+    return OPS[op] if op < len(OPS) else "-"
+
+
+def load(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    entries = []
+    for off in range(0, len(data) - ENTRY.size + 1, ENTRY.size):
+        addr, size, duration, seq, call, op, error, _ = \
+            ENTRY.unpack_from(data, off)
+        if seq != 0:
+            entries.append((seq, addr, size, duration, call, op, error))
+    # Entries are written as a ring, the sequence numbers restore the order
+    entries.sort()
+    return entries
+
+
+def log2_bucket(n):
+    return n.bit_length()
+
+
+def summary(entries):
+    print("%-8s %10s %14s %8s %12s %12s" %
+          ("call", "count", "bytes", "errors", "avg ticks", "max ticks"))
+    for c, name in enumerate(CALLS):
+        sel = [e for e in entries if e[4] == c]
+        if not sel:
+            continue
+        durations = [e[3] for e in sel]
+        print("%-8s %10d %14d %8d %12.1f %12d" %
+              (name, len(sel), sum(e[2] for e in sel),
+               sum(1 for e in sel if e[6]),
+               sum(durations) / len(sel), max(durations)))
+    print()
+
+
+def by_op(entries):
+    count = collections.Counter((op_name(e[5]), CALLS[e[4]])
+                                for e in entries if e[4] < len(CALLS))
+    print("calls by operation:")
+    for (op, call), n in sorted(count.items()):
+        print("  %-8s %-6s %10d" % (op, call, n))
+    print()
+
+
+def sizes(entries):
+    print("size distribution (bytes, log2 buckets):")
+    for c, name in enumerate(CALLS):
+        hist = collections.Counter(log2_bucket(e[2])
+                                   for e in entries if e[4] == c)
+        if not hist:
+            continue
+        print("  %s:" % name)
+        for b in sorted(hist):
+            lo = 0 if b == 0 else 1 << (b - 1)
+            print("    %10d..%-10d %10d" % (lo, (1 << b) - 1, hist[b]))
+    print()
+
+
+def sequentiality(entries):
+    print("sequentiality (call starts where the previous one of its kind "
+          "ended):")
+    for c, name in enumerate(CALLS):
+        sel = [e for e in entries if e[4] == c]
+        if len(sel) < 2:
+            continue
+        seq, runs, run = 0, [], 1
+        for prev, cur in zip(sel, sel[1:]):
+            if cur[1] == prev[1] + prev[2]:
+                seq += 1
+                run += 1
+            else:
+                runs.append(run)
+                run = 1
+        runs.append(run)
+        print("  %-6s %6.1f%% sequential, average run of %.1f calls" %
+              (name, 100.0 * seq / (len(sel) - 1), sum(runs) / len(runs)))
+    print()
+
+
+def heatmap(entries, region, top, csv):
+    heat = collections.defaultdict(lambda: [0, 0, 0])
+    for e in entries:
+        if e[4] >= len(CALLS):
+            continue
+        # A call spanning several regions counts for each of them
+        first = e[1] // region
+        last = (e[1] + max(e[2], 1) - 1) // region
+        for r in range(first, last + 1):
+            heat[r][e[4]] += 1
+    if csv:
+        with open(csv, "w") as f:
+            f.write("address,reads,writes,erases\n")
+            for r in sorted(heat):
+                f.write("%d,%d,%d,%d\n" % ((r * region,) + tuple(heat[r])))
+    print("hottest regions of %d bytes:" % region)
+    print("  %12s %10s %10s %10s" % ("address", "reads", "writes", "erases"))
+    for r in sorted(heat, key=lambda r: -sum(heat[r]))[:top]:
+        print("  0x%010x %10d %10d %10d" % ((r * region,) + tuple(heat[r])))
+
+
+def wear(entries, block):
+    count = collections.Counter()
+    for e in entries:
+        if e[4] != CALLS.index("erase"):
+            continue
+        for b in range(e[1] // block, (e[1] + max(e[2], 1) - 1) // block + 1):
+            count[b] += 1
+    print()
+    if not count:
+        print("no erases in the trace")
+        return
+    values = sorted(count.values())
+    print("erases per block of %d bytes (%d blocks erased):" %
+          (block, len(values)))
+    print("  min %d, median %d, max %d, mean %.1f" %
+          (values[0], values[len(values) // 2], values[-1],
+           sum(values) / len(values)))
+    hist = collections.Counter(log2_bucket(v) for v in values)
+    for b in sorted(hist):
+        print("    %10d..%-10d %10d blocks" %
+              (1 << (b - 1), (1 << b) - 1, hist[b]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("dump", help="raw dump of the trace buffer")
+    parser.add_argument("--region", type=int, default=4096,
+                        help="size of a heatmap region in bytes")
+    parser.add_argument("--top", type=int, default=16,
+                        help="number of heatmap regions to print")
+    parser.add_argument("--csv", help="write the full heatmap to a CSV file")
+    parser.add_argument("--erase-block", type=int,
+                        help="report the erases per erase block of this size")
+    args = parser.parse_args()
+
+    entries = load(args.dump)
+    if not entries:
+        sys.exit("no valid entries in %s" % args.dump)
+
+    print("%d entries (sequence %d to %d)\n" %
+          (len(entries), entries[0][0], entries[-1][0]))
+    summary(entries)
+    by_op(entries)
+    sizes(entries)
+    sequentiality(entries)
+    heatmap(entries, args.region, args.top, args.csv)
+    if args.erase_block:
+        wear(entries, args.erase_block)
+
+
+if __name__ == "__main__":
+    main()